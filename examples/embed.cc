@@ -0,0 +1,61 @@
+//
+// example of embedding metro (see Isolate.h)
+//
+//   make
+//   ./build/embed
+//
+// the script is compiled once, and the function is called
+// many times. an error of the script is caught as
+// ScriptError, and the isolate can be used again.
+
+#include <iostream>
+
+#include "types/Object.h"
+#include "Error.h"
+#include "Isolate.h"
+
+int main()
+{
+  Isolate isolate;
+
+  isolate.load_string(R"(
+    fn fib(n: int) -> int {
+      if n < 2 {
+        return n;
+      }
+
+      return fib(n - 1) + fib(n - 2);
+    }
+
+    fn at(v, i) {
+      return v[i];
+    }
+  )",
+                      "example.metro");
+
+  try {
+    isolate.compile();
+  }
+  catch (ScriptError const&) {
+    return 1;
+  }
+
+  for (int i = 0; i < 10; i++) {
+    // (result is valid until the next call)
+    std::cout << isolate.call("fib", i)->to_string() << " ";
+  }
+
+  std::cout << std::endl;
+
+  try {
+    isolate.call("at", std::vector<int>{1, 2, 3}, 5);
+  }
+  catch (ScriptError const& err) {
+    // (the error is shown to the output already)
+    std::cout << "caught: " << err.what() << std::endl;
+  }
+
+  std::cout << isolate.call("at", std::vector<int>{1, 2, 3}, 1)
+                   ->to_string()
+            << std::endl;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "Isolate.h"
+
+//
+// ------------------------------------------------
+//  Batch
+//
+//  metro --batch <dir> [-j N]
+//
+//  runs every script (*.metro) under the directory, each
+//  in its own isolate, on N threads in one process.
+//
+//  output of each script is collected, and shown in order
+//  of path after all finished, with the summary:
+//
+//    --- <path>
+//    <output of script>
+//    ...
+//    ok     0.001234s  <path>
+//    error  0.000567s  <path>
+//    <n> scripts, <n> ok, <n> failed (<seconds>s)
+// ------------------------------------------------
+class Batch {
+ public:
+  using Options = Isolate::Options;
+
+  Batch(Options const& options, size_t workers);
+
+  Batch(Batch const&) = delete;
+  Batch& operator=(Batch const&) = delete;
+
+  //
+  // run scripts under the directory.
+  // false if the directory cannot be read, or any failed.
+  bool run(char const* dir);
+
+ private:
+  struct Script {
+    std::string path;
+    std::string output;
+
+    double seconds = 0;
+    bool is_ok = false;
+  };
+
+  void worker_routine();
+
+  void run_script(Script& script);
+
+  Options const options;
+
+  size_t const count;  // workers
+
+  std::vector<Script> scripts;
+
+  // index of the next script to run
+  std::atomic<size_t> next;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+struct Object;
+
+//
+// ------------------------------------------------
+//  Channel
+//
+//  bounded queue of objects between threads.
+//  (multi-producer, multi-consumer)
+//
+//  the buffer is a ring of cells. each cell has a
+//  sequence number which tells whether the cell is
+//  ready to be written or read at a position, so
+//  try_send / try_recv take no lock. (a position is
+//  claimed by compare-exchange)
+//
+//  the ring has 2 cells at least, since one cell can't
+//  tell empty from full. the capacity is checked with
+//  the positions instead.
+//
+//  send / recv block until they can be done.
+//  (Scheduler is told that the thread is blocked)
+// ------------------------------------------------
+class Channel {
+ public:
+  explicit Channel(size_t capacity);
+
+  Channel(Channel const&) = delete;
+  Channel& operator=(Channel const&) = delete;
+
+  size_t capacity() const;
+
+  //
+  // false if the channel is full
+  bool try_send(Object* value);
+
+  //
+  // false if the channel is empty
+  bool try_recv(Object*& value);
+
+  //
+  // false if the channel is closed,
+  // or if it would block forever (see can_block)
+  bool send(Object* value);
+
+  //
+  // false if the channel is closed and empty,
+  // or if it would block forever (see can_block)
+  bool recv(Object*& value);
+
+  //
+  // wake up all blocked threads.
+  // the values already sent can be still received.
+  void close();
+
+  bool is_closed() const;
+
+  //
+  // call fn for each value sent and not received yet.
+  // (no thread must use the channel meanwhile)
+  void for_each(std::function<void(Object*)> const& fn) const;
+
+ private:
+  //
+  // false if no other thread can unblock the current
+  // thread. (without --threads, spawn runs the call
+  // at once, so nothing runs while blocked)
+  static bool can_block();
+
+  struct Cell {
+    std::atomic<size_t> seq;
+    Object* value;
+  };
+
+  //
+  // block until the version is changed from ver.
+  // false if can't block.
+  bool wait(size_t ver);
+
+  //
+  // change the version, and wake up the blocked threads
+  void notify();
+
+  std::unique_ptr<Cell[]> cells;
+  size_t const size;  // cells of ring
+
+  size_t const limit;  // capacity
+
+  std::atomic<size_t> send_pos;
+  std::atomic<size_t> recv_pos;
+
+  std::atomic<bool> closed;
+
+  //
+  // incremented by each send / recv / close
+  std::atomic<size_t> version;
+  std::atomic<size_t> waiters;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+};
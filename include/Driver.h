@@ -1,20 +1,72 @@
 #pragma once
 
-#include "types/Source.h"
+#include <string>
+#include <vector>
 
-struct Object;
+#include "Isolate.h"
 
 class Driver {
  public:
-  Driver();
+  using Options = Isolate::Options;
 
-  Object* execute_script();
+  Driver();
 
   int main(int argc, char** argv);
 
-  static Source const& get_current_source();
-
  private:
-  Source source;
+  bool parse_args(int argc, char** argv);
+
+  //
+  // run the script, the server (--serve), or scripts in a
+  // directory (--batch)
+  int run();
+
+  //
+  // --fork: initialize the script once, and call the entry
+  // function for each input in a forked process
+  int run_forked();
+
+  //
+  // --snapshot without --fork: call the entry function for
+  // each input in order
+  int run_entry();
+
+  //
+  // evaluate the top level, or restore it from --snapshot.
+  // (the snapshot is made if missing or out of date)
+  bool initialize(Isolate& isolate);
+
+  //
+  // call the entry function with the input (exit status)
+  int call_entry(Isolate& isolate, std::string const& input);
+
+  Options options;
+
+  char const* path;
+
+  // socket of --serve (null if not serving)
+  char const* serve_path;
+
+  // directory of --batch (null if not batch)
+  char const* batch_dir;
+
+  // threads of --serve or --batch (-j)
+  size_t workers;
+
+  // file written by --metrics at exit (null if none)
+  char const* metrics_path;
+
+  // processes run at once by --fork (0 if not forking)
+  size_t fork_count;
+
+  // function called for each input by --fork or --snapshot
+  std::string entry;
+
+  // file of --snapshot (null if none)
+  char const* snapshot_path;
+
+  // arguments after the file
+  std::vector<std::string> inputs;
+
   std::vector<std::wstring> argv;
 };
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <exception>
 #include <string>
 #include <vector>
 
@@ -36,11 +37,65 @@ enum ErrorKind {
 
   ERR_SubscriptOutOfRange,
   ERR_ValueOutOfRange,
+
+  ERR_StackOverflow,
+
+  ERR_CannotLoadNative,
+  ERR_NativeError,
+
+  ERR_UnknownTypeName,
+
+  ERR_CannotUseBreakHere,
+  ERR_AssignToSharedVariable,
+
+  ERR_SendToClosedChannel,
+  ERR_ChannelBlocksForever,
+
+  ERR_DivisionByZero,
+
+  //
+  // budgets of the run (see Isolate::Options)
+  ERR_StepLimitExceeded,
+  ERR_TimeLimitExceeded,
+  ERR_HeapLimitExceeded,
 };
 
 struct Token;
 struct Node;
 
+//
+// error thrown by Error::exit().
+// caught by try-catch of script, or by the host of isolate.
+struct ScriptError : std::exception {
+  ErrorKind kind;
+
+  std::string message;
+  std::string path;
+
+  size_t line;
+  size_t column;
+
+  ScriptError(ErrorKind kind, std::string message, std::string path,
+              size_t line, size_t column);
+
+  // "path:line:column: message"
+  char const* what() const noexcept override;
+
+  //
+  // the run is over the budget.
+  // (not caught by try of script, so that the host can
+  //  stop the run)
+  bool is_over_budget() const;
+
+ private:
+  friend class Error;
+
+  std::string location;
+
+  // shown by Error::emit (empty if not emitted)
+  std::string text;
+};
+
 class Error {
   enum LocationType : uint8_t {
     LOC_Position,
@@ -100,13 +155,36 @@ class Error {
 
   Error& set_warn();
 
+  //
+  // show the error, and record it in the isolate.
+  // (not shown if the thread is in try block of script)
   Error& emit();
 
+  //
+  // throw the first error recorded in the isolate (if any)
   static void check();
 
-  [[noreturn]] void exit(int code = 1);
+  //
+  // leave the compile or evaluation by throwing ScriptError
+  [[noreturn]] void exit();
+
+  //
+  // try blocks of script running on the current thread
+  // (see Evaluator::eval_try)
+  //
+  // threads of tasks and parallel for also enter it, since
+  // their errors are thrown again by the waiting thread.
+  static void enter_try();
+  static void leave_try();
+
+  //
+  // throw the error of other thread again.
+  // shown here if the current thread is not in try block.
+  [[noreturn]] static void rethrow(std::exception_ptr error);
 
  private:
+  ScriptError to_script_error() const;
+
   std::string create_showing_text(ErrLocation const& loc,
                                   std::string const& msg,
                                   ErrTextFormat format,
@@ -122,4 +200,7 @@ class Error {
 
   std::vector<std::pair<ErrLocation, std::vector<Suggestion*>>>
       suggest_map;
+
+  // made by emit()
+  std::string text;
 };
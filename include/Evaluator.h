@@ -1,13 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <list>
 #include <limits>
+#include <memory>
 
 #include "types/Token.h"
 #include "types/Object.h"
+#include "FrameStack.h"
+#include "LoopOptimizer.h"
+#include "GC.h"
 
-class MetroGC;
+class ThreadPool;
+struct ScriptError;
+class Scheduler;
 class Evaluator {
   struct Variable {
     Object* value;
@@ -20,31 +28,29 @@ class Evaluator {
     }
   };
 
+  //
+  // variables of scope are slots in var_stack:
+  //  var_stack[var_begin] ... var_stack[var_begin + var_count - 1]
   struct Scope {
     Node* node;
-    std::vector<Variable> variables;
+
+    size_t var_begin;
+    size_t var_count;
 
     bool is_skipped;
     Object* lastval;
 
     size_t cur_index;
 
-    explicit Scope(Node* node)
+    Scope(Node* node, size_t var_begin)
         : node(node),
+          var_begin(var_begin),
+          var_count(0),
           is_skipped(false),
           lastval(nullptr),
           cur_index(0)
     {
     }
-
-    Variable* find_var(Token* name)
-    {
-      for (auto&& v : this->variables) {
-        if (v.name == name->str) return &v;
-      }
-
-      return nullptr;
-    }
   };
 
   struct CallStack {
@@ -52,10 +58,39 @@ class Evaluator {
     bool is_returned;
     Object* result;
 
+    // pending tail call (set by return statement)
+    // arguments are in Evaluator::tail_args
+    ObjFunction* tail_func;
+    Node* tail_node;  // call of it (for errors)
+
+    // function whose return type is checked for the result
+    // (the first one declaring it, in the chain of tail calls)
+    Node* typed_func;
+
     CallStack(Node* func);
+
+    //
+    // the result of callee can be the result of this frame.
+    // (not if they declare different return types, since
+    //  only typed_func is checked)
+    bool can_tail_call(Node* callee) const;
+
+    //
+    // let this frame be of callee (for the pending tail call)
+    void jump_to(Node* callee);
   };
 
   struct LoopContext {
+    //
+    // value of ND_Induction (iterator * step)
+    // invalid if the range is not integer or overflowed,
+    // then ND_Induction computes the original expression.
+    struct Induction {
+      int64_t value;
+      int64_t step;
+      bool is_valid;
+    };
+
     Node* node;
     Object* result;
 
@@ -63,10 +98,56 @@ class Evaluator {
 
     Scope& scope;
 
+    Induction inductions[LoopOptimizer::max_inductions];
+
+    // range of loop is in bounds of the vector
+    bool guards[LoopOptimizer::max_guards];
+
     LoopContext(Node* node, Scope& scope);
   };
 
+  //
+  // values of a batch for kernels (see eval_kernel)
+  struct Batch;
+
+  //
+  // try block running.
+  // the stacks are unwound to these depths when an error
+  // is caught. (see eval_try)
+  struct TryContext {
+    Node* node;
+
+    size_t frames;  // including the frame of try (stackless)
+    size_t scopes;
+    size_t calls;
+    size_t loops;
+    size_t values;
+  };
+
+  //
+  // frame of stackless evaluation
+  struct Frame {
+    Node* node;
+    int state;
+
+    size_t index;  // index of child node in progress
+    size_t base;   // bottom of value stack for this frame
+
+    Object* value;
+    int64_t counter;
+
+    Object** slot;  // iterator of for-loop (if variable)
+
+    bool is_tail;  // callfunc in tail position
+
+    Frame(Node* node, size_t base);
+  };
+
  public:
+  //
+  // variables of the top level (name, value)
+  using Globals = std::vector<std::pair<std::string_view, Object*>>;
+
   Evaluator(MetroGC&);
   ~Evaluator();
 
@@ -74,16 +155,109 @@ class Evaluator {
   Object*& eval_lvalue(Node* node);
 
   Object* compute_expr(Node* node, Object* lhs, Object* rhs);
+  Object* compute_range(Node* node, Object* begin, Object* end);
+  bool compute_compare(Node* node, Node* item, Object*& lhs,
+                       Object*& rhs);
   Object*& compute_subscript(Node* node, Object* lhs, Object* index);
   Object*& compute_member_variable();
 
   Object* eval_scope(Scope& scope, Node* node);
 
+  //
+  // call functor with arguments on the top of value stack.
+  //  args = values[base] ... values.back()
+  Object* call_function(Node* node, ObjFunction* functor,
+                        size_t base);
+
+  //
+  // call the function from outside of script (see Isolate::call).
+  // the top level scope of root is entered while calling, so
+  // the function can find other functions on the top level.
+  // (or the scope kept by eval_globals is used)
+  Object* invoke(Node* root, ObjFunction* functor,
+                 std::vector<Object*> const& args, bool stackless);
+
+  //
+  // evaluate the top level of root, and keep its scope with
+  // the variables for invoke(), until reset().
+  Object* eval_globals(Node* root, bool stackless);
+
+  //
+  // variables kept by eval_globals, in order of definition
+  Globals get_globals();
+
+  //
+  // keep the scope of root with the variables, instead of
+  // evaluating it. (names must live as long as root)
+  void set_globals(Node* root, Globals const& vars);
+
+  //
+  // block until all tasks spawned are finished
+  void wait_tasks();
+
+  //
+  // clear all stacks after an error which is not caught
+  // by script (the evaluator can be used again)
+  void reset();
+
+  //
+  // evaluate node with an explicit stack of frames on heap,
+  // instead of native recursion of eval().
+  // the depth of calls is limited by max_frames only.
+  Object* eval_stackless(Node* node);
+
+  void set_max_frames(size_t count);
+
+  //
+  // skip runtime type checks proven by TypeChecker
+  void set_unchecked(bool flag);
+
+  //
+  // threads for parallel loops (1 = no thread)
+  void set_threads(size_t count);
+
+  //
+  // budgets of the next run (0: no limit)
+  //
+  // steps are iterations of loops and calls. workers of
+  // parallel for and tasks add their steps to the total of
+  // the run, which is checked against the limit.
+  void set_budget(uint64_t max_steps,
+                  std::chrono::milliseconds timeout);
+
  private:
+  //
+  // worker of parallel for (see eval_parallel_for),
+  // or of task (loop is null, see eval_spawn).
+  // variables of parent are visible, but not assignable.
+  Evaluator(Evaluator* parent, Node* loop);
+
+  bool is_proven(Node* node) const
+  {
+    return this->is_unchecked && node->type_checked;
+  }
+
+  //
+  // compute_expr for operands proven to be int
+  Object* compute_int_expr(Node* node, int64_t a, int64_t b);
+
+  //
+  // check the value against type annotation
+  void check_let_type(Node* node, Object* value);
+  void check_return_type(Node* callee, Object* result);
+
   //
   // find the variable matching with name->str in all entered scopes
   Object*& get_var(Token* name);
 
+  //
+  // same as get_var, but null if not found (no error)
+  Object** lookup_var(std::string_view name);
+
+  //
+  // subscript is in bounds by the guard of loop
+  bool is_guarded(Node* node);
+
   //
   // adjust the type of object for compute expr-node.
   void adjust_object_type(Object*& lhs, Object*& rhs);
@@ -96,12 +270,35 @@ class Evaluator {
   // remove scope
   void leave_scope();
 
+  //
+  // append a variable to the current scope
+  Variable& define_var(Scope& scope, Object* value,
+                       std::string_view name);
+
+  //
+  // find the variable in the scope
+  Variable* find_var(Scope& scope, Token* name);
+
+  //
+  // remove all variables of the scope
+  void release_variables(Scope& scope);
+
   //
   // get current scope
   Scope& get_cur_scope();
 
   CallStack& get_cur_call_stack();
 
+  //
+  // check if current function is already returned
+  bool is_returned();
+
+  //
+  // evaluate callee / arguments of ND_Callfunc
+  // arguments are pushed to value stack
+  ObjFunction* eval_functor(Node* node);
+  void eval_args(Node* node);
+
   //
   // continue current loop
   LoopContext& enter_for_loop(Node* node);
@@ -110,6 +307,96 @@ class Evaluator {
   // break current loop
   void leave_loop();
 
+  //
+  // declare invariants of loop and initialize inductions.
+  // called only if the loop runs at least once.
+  void enter_loop_body(Node* node, LoopContext& loopContext,
+                       Object* range);
+
+  //
+  // update inductions for the next iteration(s)
+  void step_inductions(LoopContext& loopContext, int64_t count = 1);
+
+  //
+  // evaluate the body of vectorized loop in batches,
+  // from counter to the end of target (range or vector).
+  // counter is advanced over the iterations done.
+  // returns true if all iterations are done.
+  bool eval_kernel(Node* node, LoopContext& loopContext,
+                   Object* target, int64_t& counter);
+
+  //
+  // evaluate expr for the iterators in batch.
+  // false if the batch can't be computed by kernels.
+  bool eval_batch(Node* node, Node* loop, Batch& batch,
+                  Batch const& iter, size_t count);
+
+  Object* eval_induction(Node* node);
+
+  //
+  // value of the invariant, computed at the first use in the
+  // loop, so that its error is raised where it was.
+  Object* eval_invariant(Node* node);
+
+  //
+  // evaluate parallel for.
+  // the iterations are split into chunks, which run on the
+  // threads of pool with a worker for each thread.
+  Object* eval_parallel_for(Node* node);
+
+  //
+  // evaluate iterations begin ... end - 1 of parallel for
+  // (in worker)
+  void eval_iterations(Node* node, Object* target, size_t begin,
+                       size_t end);
+
+  //
+  // error if variable is outside of parallel for (in worker)
+  void check_shared_var(Node* node);
+
+  //
+  // start the call on a task, and return the future.
+  // the call is done here if threads are not enabled.
+  Object* eval_spawn(Node* node);
+
+  //
+  // wait for the task of future, and get the result
+  Object* eval_await(Node* node);
+
+  //
+  // evaluate try block, and catch block if an error is
+  // thrown in it
+  Object* eval_try(Node* node);
+
+  //
+  // unwind the stacks for the catch block of try_stack[index]
+  void catch_error(size_t index);
+
+  //
+  // current depths of stacks, and unwind to them
+  TryContext get_context(Node* node);
+  void unwind(TryContext const& ctx);
+
+  Object* make_error_value(ScriptError const& err);
+
+  //
+  // catch the error by try frame above frame_base (stackless)
+  // false if no try frame is running
+  bool catch_error_frame(size_t frame_base, ScriptError const& err);
+
+  void push_try(Node* node);
+  void pop_try(size_t index);
+
+  //
+  // try block is running in the current function
+  // (then return doesn't do tail call)
+  bool is_in_try();
+
+  //
+  // next value of for-loop over channel.
+  // false if the channel is closed and empty.
+  bool recv_iterator(Node* node, ObjChannel* ch, Object*& value);
+
   //
   // get the LoopContext just current running
   LoopContext& get_cur_loop_context();
@@ -119,16 +406,112 @@ class Evaluator {
   void loop_continue();
   void loop_break();
 
+  //
+  // append arguments to scope of callee
+  // (trailing arguments are packed into a vector for
+  // variable arguments)
+  void bind_args(Node* node, Scope& scope, Node* callee,
+                 Object* const* args, size_t count);
+
   //
   // check arguments
   void check_user_func_args(Node* node, Node* nd_func, Scope& scope);
 
-  std::list<Scope> scope_stack;
-  std::list<CallStack> call_stack;
+  FrameStack<Scope> scope_stack;
+  FrameStack<CallStack> call_stack;
+
+  FrameStack<LoopContext> loop_stack;
+
+  FrameStack<Variable, 1024> var_stack;
+
+  //
+  // arguments of pending tail call
+  std::vector<Object*> tail_args;
+
+  std::vector<TryContext> try_stack;
 
-  std::list<LoopContext> loop_stack;
+  //
+  // root whose scope is kept by eval_globals (or null)
+  Node* globals;
+
+  //
+  // stackless evaluation
+  void step();
 
-  std::map<Node*, ObjFunction*> func_obj_map;
+  void push_frame(Node* node);
+  void finish_frame(Object* value);
+
+  Object* pop_value();
+
+  void unwind_to_call();
+  void unwind_to_loop();
+  void unwind_frame();
+
+  std::vector<Frame> frames;
+
+  //
+  // value stack.
+  // holds results of child nodes in stackless mode,
+  // and arguments of function call in both modes.
+  std::vector<Object*> values;
+
+  size_t max_frames;
+
+  //
+  // count steps, and check the budgets sometimes.
+  // (only add and compare, until next_check)
+  void count_step(Node* node, uint64_t count = 1)
+  {
+    if ((this->steps += count) >= this->next_check) {
+      this->check_budget(node);
+    }
+  }
+
+  //
+  // error if the run is over a budget
+  void check_budget(Node* node);
+
+  //
+  // error if the heap is over the limit.
+  // (also after a string or vector grew at once, which
+  //  may be too large until the next check of budget)
+  void check_heap(Node* node);
+
+  //
+  // steps since the last check (added to the total then)
+  uint64_t steps;
+  uint64_t next_check;  // (max if no budget)
+  uint64_t max_steps;   // (0 if no limit)
+
+  //
+  // steps of the run, by this and all workers.
+  // owned by the root evaluator, and shared with workers.
+  std::atomic<uint64_t> own_total_steps;
+  std::atomic<uint64_t>* total_steps;
+
+  // (max if no limit)
+  std::chrono::steady_clock::time_point deadline;
+
+  bool is_unchecked;
+
+  //
+  // workers of parallel loops (null if not enabled)
+  std::unique_ptr<ThreadPool> pool;
+
+  //
+  // tasks of spawn (null if not enabled).
+  // owned by the root evaluator, and shared with workers.
+  std::unique_ptr<Scheduler> own_scheduler;
+  Scheduler* scheduler;
+
+  //
+  // evaluator running parallel for, or spawned the task
+  // (null if not worker. only for check, it may be gone)
+  Evaluator* parent;
+
+  //
+  // count of variables copied from parent
+  size_t shared_vars;
 
   MetroGC& _gc;
 };
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cassert>
+#include <new>
+#include <utility>
+#include <vector>
+
+//
+// ------------------------------------------------
+//  FrameStack
+//
+//  stack of fixed-layout frames in contiguous chunks.
+//
+//  - elements never move, so references stay valid
+//    until the element is popped.
+//  - chunks are kept after pop, so push / pop don't
+//    touch the allocator once the stack has grown.
+// ------------------------------------------------
+template <class T, size_t ChunkSize = 256>
+class FrameStack {
+ public:
+  FrameStack()
+      : count(0)
+  {
+  }
+
+  FrameStack(FrameStack const&) = delete;
+  FrameStack& operator=(FrameStack const&) = delete;
+
+  ~FrameStack()
+  {
+    this->pop_to(0);
+
+    for (auto&& chunk : this->chunks) {
+      ::operator delete(chunk);
+    }
+  }
+
+  template <class... Args>
+  T& push(Args&&... args)
+  {
+    auto const chunk_index = this->count / ChunkSize;
+
+    if (chunk_index == this->chunks.size()) {
+      this->chunks.emplace_back(
+          static_cast<T*>(::operator new(sizeof(T) * ChunkSize)));
+    }
+
+    auto ptr = this->chunks[chunk_index] + this->count % ChunkSize;
+
+    new (ptr) T(std::forward<Args>(args)...);
+
+    this->count++;
+
+    return *ptr;
+  }
+
+  void pop()
+  {
+    assert(this->count != 0);
+
+    (*this)[--this->count].~T();
+  }
+
+  //
+  // pop elements until size() == n
+  void pop_to(size_t n)
+  {
+    while (this->count > n) {
+      this->pop();
+    }
+  }
+
+  T& top()
+  {
+    return (*this)[this->count - 1];
+  }
+
+  T& operator[](size_t index)
+  {
+    return this->chunks[index / ChunkSize][index % ChunkSize];
+  }
+
+  size_t size() const
+  {
+    return this->count;
+  }
+
+  bool empty() const
+  {
+    return this->count == 0;
+  }
+
+ private:
+  std::vector<T*> chunks;
+  size_t count;
+};
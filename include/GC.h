@@ -1,11 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <limits>
 #include <vector>
-#include <thread>
 #include <mutex>
 
 struct Object;
 
+//
+// heap of an isolate.
+// objects are registered at construction, and deleted
+// all together by stop().
+//
+// (Object::ref_count doesn't count the references from
+//  containers, results and worker threads, so objects
+//  are not swept by it while running.)
+//
+// objects of a run are deleted by release() after it, or
+// by sweep() between calls while variables are kept by
+// Isolate::initialize. not while running, so a long run
+// keeps all objects it created until it ends.
+//
+// append takes the mutex (objects are created by threads
+// of parallel for and tasks). remove() searches linearly,
+// and is only for immortal objects.
 class MetroGC {
  public:
   MetroGC();
@@ -20,18 +39,63 @@ class MetroGC {
   Object*& append(Object*);
   void remove(Object*);
 
-  void clean();
+  //
+  // the buffer of object has grown or shrunk to the bytes.
+  // (see Object::update_size)
+  void resize(Object* object, size_t bytes);
 
-  static MetroGC* get_instance();
+  //
+  // objects created after mark() are deleted by release().
+  // (objects of a call from outside, see Isolate::call)
+  size_t mark();
+  void release(size_t mark);
 
- private:
-  void _thread_routine();
-  void _sleep(int milli);
+  //
+  // delete objects created after the mark which are not
+  // reachable from roots. (through elements, results of
+  // futures and values in channels)
+  // only while no thread is running the script.
+  void sweep(size_t mark, std::vector<Object*> const& roots);
+
+  //
+  // count of slots (objects after mark() are at this or more)
+  size_t size();
+
+  //
+  // call fn for each object (mutex is locked)
+  void for_each(std::function<void(Object*)> const& fn);
+
+  //
+  // limit of bytes in the heap (0: no limit).
+  // objects are still created over it, and the evaluator
+  // stops the run at the next check. (see check_heap)
+  //
+  // bytes are counted by a fixed size of object, and the
+  // buffer of string or elements.
+  void set_limit(size_t max_bytes);
+
+  bool has_limit() const
+  {
+    return this->_limit != std::numeric_limits<size_t>::max();
+  }
 
+  bool is_over_limit() const
+  {
+    return this->_bytes.load(std::memory_order_relaxed) >
+           this->_limit;
+  }
+
+ private:
   bool _is_running;
   bool _is_pausing;
   std::vector<Object*> _objects;
 
-  std::unique_ptr<std::thread> _routine;
+  // indices of empty slots in _objects
+  std::vector<size_t> _free_slots;
+
+  // bytes in the heap, and the limit (max if no limit)
+  std::atomic<size_t> _bytes;
+  size_t _limit;
+
   std::mutex _mtx;
 };
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <map>
+#include <string_view>
+#include <vector>
+
+struct Node;
+struct Token;
+struct Source;
+
+//
+// ------------------------------------------------
+//  Inliner
+//
+//  replace calls of small functions with the body.
+//
+//  a function is inlined if
+//  - it is called by name (bound by Resolver)
+//  - it doesn't call any user function
+//    (so it is not recursive, and callee can't see
+//     its arguments through dynamic scope)
+//  - it returns only at the end of the body
+//  - the body has at most max_size nodes
+//
+//  arguments and local variables are renamed to
+//  "name@N", which can't be written in source.
+// ------------------------------------------------
+class Inliner {
+ public:
+  static constexpr size_t default_max_size = 32;
+
+  //
+  // names of renamed variables are kept in source
+  Inliner(Node* root, Source& source,
+          size_t max_size = default_max_size);
+
+  void inline_all();
+
+ private:
+  enum State {
+    ST_None,
+    ST_Visiting,
+    ST_Inlinable,
+    ST_NotInlinable,
+  };
+
+  void walk(Node*& node);
+  void prepare(Node* func);
+
+  bool is_inlinable(Node* func);
+  bool check_body(Node* node, bool is_tail);
+
+  Node* expand(Node* call, Node* func);
+
+  Node* clone(Node* node);
+  Node* strip_return(Node* node);
+
+  Token* rename(Token* token);
+  Token* find_rename(std::string_view name);
+
+  Node* root;
+  Source& source;
+  size_t max_size;
+
+  std::map<Node*, State> states;
+
+  // renamed variables in current expansion
+  std::vector<std::pair<std::string_view, Token*>> renames;
+
+  // argument --> node (substituted directly)
+  std::map<std::string_view, Node*> substitutes;
+
+  size_t count;
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <concepts>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "types/Source.h"
+#include "Error.h"
+#include "GC.h"
+#include "Inliner.h"
+#include "NativeModule.h"
+
+struct Object;
+struct Node;
+struct ObjFunction;
+class Evaluator;
+
+//
+// ------------------------------------------------
+//  Isolate
+//
+//  an interpreter instance which runs a script.
+//  it has the source, heap, native modules and error
+//  state, and shares nothing with other isolates, so
+//  isolates can run at the same time on different
+//  threads. (an isolate is used by one thread at a time)
+//
+//  the script is compiled once, then executed or called
+//  by functions many times.
+//
+//  objects and errors are created in the isolate which
+//  the current thread has entered. (see Scope)
+//  threads of ThreadPool and Scheduler enter the isolate
+//  of the thread which created them.
+// ------------------------------------------------
+class Isolate {
+ public:
+  struct Options {
+    // evaluate with explicit frame stack (Evaluator::eval_stackless)
+    bool stackless = false;
+
+    // limit of frames in stackless mode
+    size_t max_frames = 1 << 20;
+
+    // skip runtime type checks proven by TypeChecker
+    bool unchecked = false;
+
+    // inline small functions (see Inliner)
+    bool inline_functions = true;
+    size_t inline_size = Inliner::default_max_size;
+
+    // optimize for-loops (see LoopOptimizer)
+    bool optimize_loops = true;
+
+    // evaluate simple loops by SIMD kernels (see Kernel.h)
+    bool vectorize_loops = true;
+
+    // threads for vectorized loops (--parallel)
+    size_t threads = 1;
+
+    //
+    // budgets of each execute() or call() (0: no limit).
+    // a run over them is stopped by an error, which is not
+    // caught by try of script. (see ScriptError)
+
+    // iterations of loops and calls
+    uint64_t max_steps = 0;
+
+    // wall-clock time in milliseconds
+    uint64_t timeout_ms = 0;
+
+    // bytes in the heap (see MetroGC::set_limit)
+    size_t max_heap = 0;
+  };
+
+  //
+  // enter the isolate on the current thread.
+  // the previous one is entered again at the end of scope.
+  class Scope {
+   public:
+    explicit Scope(Isolate* isolate);
+    ~Scope();
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+   private:
+    Isolate* prev;
+  };
+
+  Isolate();
+  explicit Isolate(Options const& options);
+
+  //
+  // objects in the heap are deleted
+  ~Isolate();
+
+  Isolate(Isolate const&) = delete;
+  Isolate& operator=(Isolate const&) = delete;
+
+  bool load_file(char const* path);
+
+  //
+  // load the script from memory (name is shown in errors)
+  void load_string(std::string const& text,
+                   char const* name = "<string>");
+
+  //
+  // compile the source.
+  // execute() and call() compile it if not compiled yet.
+  //
+  // errors are thrown as ScriptError by compile(), execute()
+  // and call(), after they are shown. (see get_errors)
+  // the isolate can be used again after the error.
+  void compile();
+
+  //
+  // evaluate the source.
+  // the result is valid until the next execute() or call(),
+  // since objects created by it are deleted then.
+  Object* execute();
+
+  //
+  // evaluate the top level, and keep its variables for the
+  // following call(). (until execute())
+  // objects of calls are swept by a later call instead of
+  // deleted, since the variables may refer them. (when the
+  // heap has doubled since the last sweep)
+  //
+  // objects are never deleted while a run, so one long
+  // call or execute() keeps all objects it created until
+  // it ends. (see MetroGC)
+  Object* initialize();
+
+  //
+  // the variables of initialize() (or a snapshot) are kept.
+  // (false after execute())
+  bool is_initialized() const;
+
+  //
+  // fork the process with a copy of the isolate, which
+  // shares the memory copy-on-write. (returns as fork())
+  //
+  // threads are not copied by fork, so the threads of the
+  // isolate are stopped before, and started again in the
+  // child. (the parent has no thread after this)
+  pid_t fork();
+
+  //
+  // save the variables kept by initialize() to the file.
+  // (see Snapshot)
+  bool save_snapshot(char const* path);
+
+  //
+  // restore the variables saved by save_snapshot, instead
+  // of initialize(). false if the file is not valid for the
+  // source and options.
+  bool restore_snapshot(char const* path);
+
+  //
+  // call the function on the top level of script by name.
+  // native arguments are converted by to_object().
+  //
+  // statements on the top level are not evaluated.
+  // the result is valid until the next call, since objects
+  // created by the call are deleted then.
+  // null if the function is not found.
+  template <class... Args>
+  Object* call(std::string_view name, Args&&... args)
+  {
+    Scope scope{this};
+
+    auto func = this->prepare_call(name);
+
+    if (!func) {
+      return nullptr;
+    }
+
+    return this->invoke(func,
+                        {to_object(std::forward<Args>(args))...});
+  }
+
+  //
+  // native value of an argument known at runtime
+  using Value = std::variant<int64_t, double, bool, std::string>;
+
+  //
+  // call() with the arguments in vector
+  Object* call_values(std::string_view name,
+                      std::vector<Value> const& args);
+
+  //
+  // native values to objects (in the current isolate)
+  static Object* to_object(Object* obj);
+  static Object* to_object(bool value);
+  static Object* to_object(double value);
+  static Object* to_object(char const* str);
+  static Object* to_object(std::string_view str);
+
+  template <std::integral T>
+  static Object* to_object(T value)
+  {
+    return make_int(value);
+  }
+
+  template <class T>
+  static Object* to_object(std::vector<T> const& values)
+  {
+    std::vector<Object*> elements;
+
+    for (auto&& x : values) {
+      elements.emplace_back(to_object(x));
+    }
+
+    return make_vector(std::move(elements));
+  }
+
+  Source const& get_source() const;
+  MetroGC& get_heap();
+  NativeModule& get_natives();
+
+  //
+  // stream for print functions and errors (std::cout default)
+  void set_output(std::ostream& out);
+
+  //
+  // write to the output (from any thread of the isolate)
+  // flushed if the text ends with a new line.
+  void write(std::string_view text);
+
+  //
+  // errors emitted by the last compile, execute() or call()
+  // (see Error::emit)
+  void add_error(ScriptError&& err);
+  std::vector<ScriptError> const& get_errors() const;
+
+  //
+  // isolate of the current thread (null if none)
+  static Isolate* current();
+
+ private:
+  static Object* make_int(int64_t value);
+  static Object* make_vector(std::vector<Object*>&& elements);
+
+  //
+  // compile, and delete objects of the previous execute()
+  // or call() (tasks spawned by it are finished before)
+  void prepare();
+
+  //
+  // prepare, and find the function (null if not found)
+  ObjFunction* prepare_call(std::string_view name);
+
+  Object* invoke(ObjFunction* func,
+                 std::vector<Object*> const& args);
+
+  //
+  // delete objects which the variables kept by initialize
+  // don't refer. (between calls)
+  void sweep();
+
+  //
+  // stop the evaluation after an error which is not caught.
+  // channels are closed, so that blocked tasks can finish.
+  void abort();
+
+  Options options;
+
+  Source source;
+  MetroGC heap;
+  NativeModule natives;
+
+  std::ostream* output;
+  std::mutex output_mutex;
+
+  std::vector<ScriptError> errors;
+
+  //
+  // compiled script (null if not compiled)
+  Node* program;
+
+  std::unique_ptr<Evaluator> evaluator;
+
+  //
+  // objects after this are created by the last execute()
+  // or call()
+  size_t call_mark;
+
+  //
+  // objects after this are created by runs (not constants
+  // of the program), and swept by the size of heap.
+  size_t program_mark;
+  size_t sweep_at;
+
+  //
+  // top level is evaluated by initialize()
+  bool has_globals;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "types/Node.h"
+
+//
+// ------------------------------------------------
+//  Kernel
+//
+//  element-wise operations on batches of unboxed
+//  values, for the body of vectorized for-loop.
+//  (see LoopOptimizer, Evaluator::eval_kernel)
+//
+//  the instruction set is selected at runtime:
+//  AVX2, SSE2 or scalar.
+//
+//  the result is same as compute_expr for each
+//  element. operation returns false if any element
+//  overflows, then the batch is evaluated again by
+//  the normal evaluation which reports the error.
+// ------------------------------------------------
+namespace Kernel {
+
+// count of elements in a batch
+constexpr size_t batch_size = 256;
+
+//
+// dest[i] = a[i] <kind> b[i]
+bool compute(NodeKind kind, int64_t* dest, int64_t const* a,
+             int64_t const* b, size_t count);
+
+bool compute(NodeKind kind, float* dest, float const* a,
+             float const* b, size_t count);
+
+}  // namespace Kernel
+
+template <class T>
+bool is_overflow(NodeKind kind, T a, T b)
+{
+  using limits = std::numeric_limits<T>;
+
+  switch (kind) {
+    case ND_Add:
+      return (a > 0 && b > 0 && a > limits::max() - b) ||
+             (a < 0 && b < 0 && a < limits::min() - b);
+
+    case ND_Sub:
+      return (a > 0 && b < 0 && a > limits::max() + b) ||
+             (a < 0 && b > 0 && a < limits::min() + b);
+
+    case ND_Mul:
+      return (a > 0 && b > 0 && a > limits::max() / b) ||
+             (a > 0 && b < 0 && b < limits::min() / a) ||
+             (a < 0 && b > 0 && a < limits::min() / b) ||
+             (a < 0 && b < 0 && b < limits::max() / a);
+
+    default:
+      return false;
+  }
+}
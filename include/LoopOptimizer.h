@@ -0,0 +1,116 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string_view>
+
+struct Node;
+struct Source;
+
+//
+// ------------------------------------------------
+//  LoopOptimizer
+//
+//  optimize the body of for-loops.
+//
+//  - loop-invariant code motion:
+//    pure expressions which don't depend on the loop
+//    are computed once in the loop, at the first use
+//    (ND_Invariant), and kept by variables declared in
+//    the preheader of loop (Node::nd_for_preheader) as
+//    "let @invN". so an error of them is raised where
+//    the original expression is.
+//
+//  - strength reduction:
+//    "iterator * step" is replaced with ND_Induction.
+//    the value is updated by addition in every
+//    iteration (see Evaluator::LoopContext).
+//
+//  - bounds-check elimination:
+//    "v[iterator]" is guarded by the loop, if the
+//    loop doesn't assign v or resize any vector.
+//    the range is checked against v only once when
+//    the loop is entered.
+//
+//  - unboxed counter:
+//    if the iterator is only read as an operand,
+//    the range loop reuses one counter object
+//    instead of allocating it in every iteration.
+//
+//  - vectorization:
+//    if the body is only "v[iterator] = expr" of
+//    arithmetic on numbers, or reductions such as
+//    "sum = sum + expr", the loop is evaluated in
+//    batches by SIMD kernels (see Kernel.h).
+//    iterations of such loop are independent, so the
+//    batches run in parallel with --parallel.
+//
+//  a loop is not optimized if the body calls a user
+//  function, since callee can assign any variable
+//  through dynamic scope. parallel for is not optimized
+//  either. (loops in its body are)
+// ------------------------------------------------
+class LoopOptimizer {
+ public:
+  // limit of ND_Induction per loop
+  static constexpr size_t max_inductions = 4;
+
+  // limit of guarded vectors per loop
+  static constexpr size_t max_guards = 4;
+
+  //
+  // names of invariants are kept in source
+  LoopOptimizer(Node* root, Source& source, bool vectorize = true);
+
+  void optimize();
+
+ private:
+  void walk(Node* node);
+  void optimize_loop(Node* node);
+
+  //
+  // collect variables assigned in loop
+  void scan(Node* node);
+
+  bool is_invariant(Node* node);
+  bool is_iterator(Node* node);
+
+  //
+  // the value of iterator may be kept after the iteration
+  bool is_captured(Node* node);
+  bool is_captured_operand(Node* node);
+
+  //
+  // node is evaluated in every iteration
+  void hoist(Node*& node);
+  void reduce(Node*& node);
+  void guard(Node* node);
+
+  //
+  // body of loop can be evaluated by kernels
+  bool is_vectorizable(Node* code);
+  bool is_kernel_expr(Node* node);
+  bool is_reduction(Node* node);
+
+  Node* new_invariant(Node* expr);
+  Node* new_induction(Node* expr, Node* step);
+
+  Node* root;
+  Source& source;
+  bool vectorize;
+
+  // current loop
+  Node* loop;
+  std::string_view iterator;
+
+  std::set<std::string_view> assigned;
+
+  // vector --> index of guard
+  std::map<std::string_view, size_t> guards;
+
+  bool has_call;    // calls user function
+  bool has_write;   // modifies vector
+  bool has_resize;  // appends to vector
+
+  size_t count;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//
+// ------------------------------------------------
+//  Histogram
+//
+//  latency histogram in nanoseconds.
+//
+//  each power of 2 is split into 4 buckets, so a quantile
+//  is the upper bound of its bucket (error < 25%).
+//  recording is lock-free, and can be done by any thread.
+// ------------------------------------------------
+class Histogram {
+ public:
+  static constexpr size_t bucket_count = 252;
+
+  void record(uint64_t ns);
+
+  uint64_t get_count() const;
+  uint64_t get_sum() const;
+  uint64_t get_max() const;
+
+  //
+  // upper bound of the q-quantile (0 <= q <= 1)
+  uint64_t quantile(double q) const;
+
+ private:
+  static size_t index_of(uint64_t ns);
+  static uint64_t upper_bound(size_t index);
+
+  std::atomic<uint64_t> buckets[bucket_count]{};
+
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> max{0};
+};
+
+//
+// ------------------------------------------------
+//  Metrics
+//
+//  counters and histograms of the process, shown in
+//  plain text by to_text(). (request "metrics" of Server,
+//  or --metrics <file>)
+//
+//  a metric is created at the first use of its name and
+//  labels, and lives until the process exits, so the
+//  reference can be kept.
+//
+//  builtin functions are measured only if enabled.
+// ------------------------------------------------
+class Metrics {
+ public:
+  static void enable();
+
+  static bool is_enabled()
+  {
+    return enabled.load(std::memory_order_relaxed);
+  }
+
+  //
+  // counter or gauge.
+  // labels are like `path="a.metro"` (see label)
+  static std::atomic<int64_t>& counter(
+      std::string const& name, std::string const& labels = "");
+
+  static Histogram& histogram(std::string const& name,
+                              std::string const& labels = "");
+
+  //
+  // key="value" (value is escaped)
+  static std::string label(std::string_view key,
+                           std::string_view value);
+
+  //
+  // counters, then histograms (sorted by name)
+  static std::string to_text();
+
+  static bool write_file(char const* path);
+
+  //
+  // record the time until the end of scope
+  class Timer {
+   public:
+    explicit Timer(Histogram& histogram);
+    ~Timer();
+
+    Timer(Timer const&) = delete;
+    Timer& operator=(Timer const&) = delete;
+
+   private:
+    Histogram& histogram;
+
+    std::chrono::steady_clock::time_point begin;
+  };
+
+ private:
+  static std::atomic<bool> enabled;
+};
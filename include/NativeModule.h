@@ -0,0 +1,54 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "types/BuiltinFunc.h"
+
+struct Node;
+
+//
+// ------------------------------------------------
+//  NativeModule
+//
+//  shared libraries loaded by import_native() in an
+//  isolate. functions registered by them are found with
+//  BuiltinFunc::find, same as builtin functions.
+//
+//  libraries are never unloaded. (a library imported by
+//  other isolate is initialized again for this one)
+// ------------------------------------------------
+class NativeModule {
+ public:
+  NativeModule();
+
+  NativeModule(NativeModule const&) = delete;
+  NativeModule& operator=(NativeModule const&) = delete;
+
+  //
+  // load a shared library and call its init function.
+  // loading same path twice does nothing.
+  void load(Node* node, std::string const& path);
+
+  BuiltinFunc const* find(std::string_view name) const;
+
+  //
+  // register a function (called by init function)
+  void define(char const* name, BuiltinFunc::NativeType fn);
+
+ private:
+  //
+  // registered functions
+  // (deque: addresses of elements never change)
+  std::deque<std::string> names;
+  std::deque<BuiltinFunc> functions;
+  std::map<std::string_view, BuiltinFunc const*> table;
+
+  std::set<std::string> loaded_paths;
+
+  // import_native() which is loading now
+  Node* loading_node;
+};
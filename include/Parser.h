@@ -72,6 +72,7 @@ class Parser {
       std::function<Node*(Parser*)> chi = &Parser::expr);
 
   Node* to_return_stmt(Node* node);
+  bool is_tail_rewritable(Node* node);
 
   Object* check_value_range(Token* token);
 
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string_view>
+#include <vector>
+
+struct Node;
+
+//
+// ------------------------------------------------
+//  Resolver
+//
+//  build the table of functions before evaluation.
+//
+//  - create one function object for each ND_Function
+//    and each builtin function.
+//  - bind ND_Variable to the function object directly,
+//    if the name can't be anything else.
+// ------------------------------------------------
+class Resolver {
+ public:
+  explicit Resolver(Node* root);
+
+  void resolve();
+
+ private:
+  void collect(Node* node);
+  void bind(Node* node);
+
+  Node* root;
+
+  // name --> ND_Function nodes
+  std::map<std::string_view, std::vector<Node*>> functions;
+
+  // names which are used as variable
+  std::set<std::string_view> variable_names;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Isolate;
+
+//
+// ------------------------------------------------
+//  Scheduler
+//
+//  threads for tasks started by spawn.
+//
+//  each thread has a deque of tasks. a task spawned
+//  in a thread is pushed to the back of its deque, and
+//  taken from the back (newest first). a thread which
+//  has no task steals the oldest task of other thread.
+//  tasks spawned outside of the threads are pushed to
+//  the shared deque.
+//
+//  a blocked thread (wait, channel) doesn't run other
+//  tasks, since the task may wait for the blocked thread
+//  itself. instead, a new thread is started if tasks are
+//  queued and fewer threads than count + 1 are running,
+//  so tasks waiting for each other never block all
+//  threads. (up to max_spare_threads)
+//
+//  tasks are coarse (a function call), so one mutex
+//  guards all deques.
+// ------------------------------------------------
+class Scheduler {
+ public:
+  using Task = std::function<void()>;
+
+  explicit Scheduler(size_t count);
+
+  //
+  // wait for all tasks, then stop threads
+  ~Scheduler();
+
+  Scheduler(Scheduler const&) = delete;
+  Scheduler& operator=(Scheduler const&) = delete;
+
+  void submit(Task&& task);
+
+  //
+  // block until is_done() returns true.
+  // (is_done is called with the mutex locked)
+  void wait(std::function<bool()> const& is_done);
+
+  //
+  // block until all tasks submitted are finished
+  void wait_all();
+
+  //
+  // wake up the threads in wait()
+  void notify();
+
+  //
+  // the current thread is blocked by other than wait()
+  void enter_blocking();
+  void leave_blocking();
+
+  //
+  // scheduler of the current thread (null if none)
+  static Scheduler* current();
+
+ private:
+  void worker_routine(size_t id);
+
+  //
+  // take a task for the current thread (mutex is locked)
+  bool take(Task& task);
+
+  //
+  // run the task, and wake up the waiting threads
+  void run(Task& task);
+
+  //
+  // start a thread if no thread can run the queued tasks
+  // (mutex is locked)
+  void compensate();
+
+  // isolate of the creator (entered by workers)
+  Isolate* isolate;
+
+  std::vector<std::thread> workers;
+
+  //
+  // deques[0 ... count - 1] : threads
+  // deques[count]           : shared
+  //
+  // (threads started by compensate() use the shared one)
+  std::vector<std::deque<Task>> deques;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  //
+  // threads to keep running (including the creator)
+  size_t const parallelism;
+
+  size_t pending;  // submitted and not finished
+
+  size_t idle;     // threads waiting for a task
+  size_t blocked;  // threads blocked in wait / enter_blocking
+
+  bool is_stopped;
+};
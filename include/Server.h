@@ -0,0 +1,136 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Isolate.h"
+#include "Metrics.h"
+
+//
+// ------------------------------------------------
+//  Server
+//
+//  metro --serve <socket>
+//
+//  keeps compiled scripts warm, and runs requests sent
+//  over a unix domain socket on a pool of isolates.
+//
+//  a request is one line (a connection can send many):
+//
+//    run <path>                     evaluate the script
+//    call <path> <name> [args...]   call the function
+//    metrics                        show Metrics::to_text()
+//    quit                           stop the server
+//
+//  arguments are separated by spaces, and converted to
+//  int, float, bool (true, false), or else string.
+//
+//  call evaluates the top level of the script first, if
+//  the isolate has not yet (its output is in the body).
+//  the variables are kept by the isolate for later calls,
+//  until a run on it. (see Isolate::initialize)
+//
+//  a response is a header line and the body:
+//
+//    ok <size>\n<body>
+//    error <size>\n<body>
+//
+//  body is the output of script, and the result of call
+//  (or "path:line:column: message" of the error) in the
+//  last line.
+//
+//  isolates are cached for each script, and compiled
+//  again when the file is modified.
+//
+//  metrics of requests:
+//    requests_total, request_errors_total,
+//    request_seconds           : for each script (path)
+//    queue_depth               : connections not handled yet
+//    queue_wait_seconds        : time until handled
+//    connections               : connections being handled
+// ------------------------------------------------
+class Server {
+ public:
+  using Options = Isolate::Options;
+
+  Server(Options const& options, size_t workers);
+  ~Server();
+
+  Server(Server const&) = delete;
+  Server& operator=(Server const&) = delete;
+
+  //
+  // listen on the socket, and serve until quit.
+  // false if the socket cannot be listened.
+  bool serve(char const* path);
+
+ private:
+  using FileTime = std::filesystem::file_time_type;
+  using Clock = std::chrono::steady_clock;
+
+  //
+  // compiled isolates of a script (not used now)
+  struct Script {
+    FileTime mtime;
+
+    std::vector<std::unique_ptr<Isolate>> idle;
+  };
+
+  void worker_routine();
+
+  //
+  // read requests from the connection until it is closed
+  void handle(int fd);
+
+  //
+  // run the request, and make the response
+  std::string respond(std::string const& line);
+
+  //
+  // take an isolate of the script, or create new one.
+  // (compiled by the caller)
+  std::unique_ptr<Isolate> take(std::string const& path,
+                                FileTime mtime);
+
+  //
+  // put the isolate back, unless the script is modified
+  void put(std::string const& path, FileTime mtime,
+           std::unique_ptr<Isolate>&& isolate);
+
+  void stop();
+
+  Options const options;
+
+  size_t const count;  // workers
+
+  int listen_fd;
+
+  std::vector<std::thread> workers;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  // connections not handled yet, and accepted time
+  std::deque<std::pair<int, Clock::time_point>> accepted;
+
+  // connections being handled
+  std::set<int> handling;
+
+  // (see Metrics)
+  std::atomic<int64_t>& queue_depth;
+  Histogram& queue_wait;
+  std::atomic<int64_t>& connections;
+
+  std::map<std::string, Script> scripts;
+
+  bool is_stopped;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Evaluator.h"
+#include "Isolate.h"
+
+//
+// ------------------------------------------------
+//  Snapshot
+//
+//  metro --snapshot <file> [file] [inputs...]
+//
+//  the variables of the top level kept by
+//  Isolate::initialize, and all objects reachable from
+//  them, saved to a file. restoring it gives the same
+//  state without evaluating the top level again.
+//
+//  pointers are saved as indices of objects, and relocated
+//  to the new objects when restored. (objects shared by
+//  variables or elements are still shared)
+//
+//  functions are saved by name. (functions of the top
+//  level, and builtin functions)
+//  futures and channels cannot be saved.
+//
+//  a snapshot is valid only for the same source and
+//  options of compile, which are checked by the hash.
+// ------------------------------------------------
+class Snapshot {
+ public:
+  using Globals = Evaluator::Globals;
+
+  //
+  // hash of the source and options of compile
+  static uint64_t hash_of(Source const& source,
+                          Isolate::Options const& options);
+
+  //
+  // save variables of the top level of root.
+  // false if cannot (the reason is shown)
+  static bool write(char const* path, uint64_t hash, Node* root,
+                    Globals const& vars);
+
+  //
+  // create the objects in the current isolate, and get the
+  // variables. (names are of the tokens of root)
+  // false if the file is not valid (the reason is shown)
+  static bool read(char const* path, uint64_t hash, Node* root,
+                   Globals& vars);
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Isolate;
+
+//
+// ------------------------------------------------
+//  ThreadPool
+//
+//  fixed threads for data-parallel tasks.
+//  run() calls the function for each index on all
+//  threads (including the caller), and returns when
+//  all of them are done.
+//
+//  if the function throws, the other threads stop
+//  taking indices, and the first exception is thrown
+//  again by the caller.
+// ------------------------------------------------
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t count);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  //
+  // count of threads (including the caller of run)
+  size_t size() const;
+
+  //
+  // fn(0) ... fn(count - 1)
+  void run(size_t count, std::function<void(size_t)> const& fn);
+
+  //
+  // split 0 ... count - 1 into chunks of grain (or less),
+  // and call fn(thread, begin, end) for each chunk.
+  // thread is 0 ... size() - 1 (0 is the caller).
+  //
+  // each thread takes chunks from the front of its own part,
+  // and steals the latter half of another part when its own
+  // part is empty. (work-stealing)
+  void run_split(
+      size_t count, size_t grain,
+      std::function<void(size_t, size_t, size_t)> const& fn);
+
+  //
+  // pool of the current thread (null if not a worker)
+  static ThreadPool* current();
+
+ private:
+  //
+  // call job(thread) on all threads, and wait for them
+  void dispatch(std::function<void(size_t)> const& job);
+
+  //
+  // call job(thread), and keep the exception
+  void run_job(std::function<void(size_t)> const& job, size_t id);
+
+  void worker_routine(size_t id);
+
+  // isolate of the creator (entered by workers)
+  Isolate* isolate;
+
+  std::vector<std::thread> workers;
+
+  std::mutex mtx;
+  std::condition_variable cv_start;
+  std::condition_variable cv_done;
+
+  std::function<void(size_t)> const* job;
+
+  size_t running;     // workers in the current job
+  size_t generation;  // incremented by dispatch()
+
+  // first exception of the current job
+  std::exception_ptr error;
+  std::atomic<bool> is_failed;
+
+  bool is_stopped;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string_view>
+#include <vector>
+
+#include "types/Type.h"
+
+struct Node;
+
+//
+// ------------------------------------------------
+//  TypeChecker
+//
+//  infer types from annotations and literals before
+//  evaluation, and report mismatches.
+//
+//  - Node::expr_type is set to the proven type of
+//    each expression (TYPE_None if unknown).
+//  - Node::type_checked is set if the runtime type
+//    check of the node is redundant.
+//    the evaluator skips them in unchecked mode.
+//
+//  variables are resolved lexically inside a function.
+//  free variables of a function are dynamically
+//  scoped, so their types are unknown.
+//  so are uses in a loop body of a name declared again
+//  later in the body, which find the variable of the
+//  body from the second iteration.
+// ------------------------------------------------
+class TypeChecker {
+ public:
+  explicit TypeChecker(Node* root);
+
+  void check();
+
+ private:
+  struct Variable {
+    std::string_view name;
+    Node* decl;  // ND_Let, ND_Argument, ND_For or ND_Try
+  };
+
+  struct Loop {
+    size_t base;  // index of variables where the loop begins
+
+    // names declared by let in the body
+    std::set<std::string_view> names;
+  };
+
+  TypeKind walk(Node* node);
+  TypeKind walk_compare(Node* node, bool& checked);
+  TypeKind walk_callfunc(Node* node);
+
+  TypeKind get_annotation(Node* type);
+
+  Node* find_decl(std::string_view name);
+
+  bool is_rebound(std::string_view name);
+
+  TypeKind get_var_type(Node* decl, std::string_view name);
+
+  void declare(Node* decl, std::string_view name, TypeKind type,
+               bool is_annotated);
+
+  void assign(Node* node, Node* decl, std::string_view name,
+              TypeKind type);
+
+  void mark(Node* node, TypeKind type, bool checked);
+
+  Node* root;
+
+  // last pass : mark nodes and report errors
+  bool is_final;
+
+  // type of some variable has changed in this pass
+  bool is_changed;
+
+  // lexical scope
+  std::vector<Variable> variables;
+
+  // index of variables where current function begins
+  std::vector<size_t> func_bases;
+  std::vector<Node*> functions;
+
+  // loops being walked
+  std::vector<Loop> loops;
+
+  // declaration --> type
+  std::map<Node*, TypeKind> var_types;
+  std::map<Node*, TypeKind> annotations;
+
+  // names assigned as free variable in some function
+  std::set<std::string_view> free_assigned;
+};
@@ -138,7 +138,8 @@ using std::to_string;
 template <class... Args>
 std::string format(char const* fmt, Args&&... args)
 {
-  static char buf[0x1000];
+  // (per thread, since isolates may run in parallel)
+  thread_local char buf[0x1000];
   sprintf(buf, fmt, args...);
   return buf;
 }
@@ -208,8 +209,9 @@ std::string join(std::string const& s, std::list<T> const& list,
 }
 
 class Converter {
-  static inline std::wstring_convert<std::codecvt_utf8<wchar_t>,
-                                     wchar_t>
+  // (one for each thread, since it has a conversion state)
+  static inline thread_local std::wstring_convert<
+      std::codecvt_utf8<wchar_t>, wchar_t>
       conv;
 
  public:
@@ -0,0 +1,103 @@
+#pragma once
+
+//
+// ------------------------------------------------
+//  metro native extension ABI
+//
+//  a plugin is a shared library which exports
+//
+//    int metro_native_init(metro_api const* api);
+//
+//  and registers its functions with api->define().
+//  it is loaded from a script by
+//
+//    import_native("libfoo.so");
+//
+//  values are opaque. read them with the accessors
+//  after checking api->type_of(), and create them
+//  with api->new_*() (allocated through the GC).
+//
+//  return non-zero from metro_native_init to reject
+//  loading.
+// ------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRO_NATIVE_ABI_VERSION 1
+
+typedef struct Object metro_value;
+typedef struct Node metro_node;
+
+// same values as TypeKind
+typedef enum metro_type {
+  METRO_TYPE_NONE,
+  METRO_TYPE_INT,
+  METRO_TYPE_FLOAT,
+  METRO_TYPE_BOOL,
+  METRO_TYPE_CHAR,
+  METRO_TYPE_STRING,
+  METRO_TYPE_TUPLE,
+  METRO_TYPE_VECTOR,
+  METRO_TYPE_RANGE,
+  METRO_TYPE_ARGS,
+  METRO_TYPE_FUNCTION,
+  METRO_TYPE_FUTURE,
+  METRO_TYPE_CHANNEL
+} metro_type;
+
+//
+// node : the call expression, for error reporting
+// args : evaluated arguments
+typedef metro_value* (*metro_native_fn)(metro_node* node,
+                                        metro_value* const* args,
+                                        size_t argc);
+
+typedef struct metro_api {
+  uint32_t abi_version;
+
+  // register a builtin function
+  void (*define)(char const* name, metro_native_fn fn);
+
+  // ---- accessors ----
+  metro_type (*type_of)(metro_value const* value);
+
+  int64_t (*get_int)(metro_value const* value);
+  double (*get_float)(metro_value const* value);
+  int (*get_bool)(metro_value const* value);
+
+  // copy utf-8 string into buf (null terminated if size != 0)
+  // returns the length without null terminator
+  size_t (*get_string)(metro_value const* value, char* buf,
+                       size_t size);
+
+  // vector / tuple
+  size_t (*list_size)(metro_value const* value);
+  metro_value* (*list_at)(metro_value const* value, size_t index);
+
+  // ---- constructors ----
+  metro_value* (*new_none)(void);
+  metro_value* (*new_int)(int64_t value);
+  metro_value* (*new_float)(double value);
+  metro_value* (*new_bool)(int value);
+  metro_value* (*new_string)(char const* utf8, size_t length);
+  metro_value* (*new_vector)(void);
+
+  void (*vector_append)(metro_value* vec, metro_value* value);
+
+  // ---- error ----
+  // report an error at node and stop the script
+  void (*error)(metro_node* node, char const* message);
+} metro_api;
+
+typedef int (*metro_native_init_fn)(metro_api const* api);
+
+#define METRO_NATIVE_INIT_NAME "metro_native_init"
+
+#ifdef __cplusplus
+}
+#endif
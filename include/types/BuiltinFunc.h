@@ -1,19 +1,81 @@
 #pragma once
 
-#include <vector>
-#include <functional>
+#include <atomic>
+#include <span>
+#include <string_view>
+
+#include "metro_native.h"
+#include "Metrics.h"
 
 struct Object;
+struct ObjFunction;
 struct Node;
 
+//
+// arguments of builtin function
+// (view of the evaluator's value stack, no copy)
+using BF_Args = std::span<Object* const>;
+
 struct BuiltinFunc {
-  using FuncType =
-      std::function<Object*(Node*, std::vector<Object*> const&)>;
+  using FuncType = Object* (*)(Node*, BF_Args);
+  using NativeType = metro_native_fn;
 
   char const* name;
   FuncType func;
 
-  BuiltinFunc(char const* name, FuncType func);
+  // function in a native module (see NativeModule)
+  NativeType native;
+
+  // function object shared by all call sites
+  // (created by ObjFunction::from_builtin)
+  mutable std::atomic<ObjFunction*> object;
+
+  // time of calls (created by call_timed)
+  mutable std::atomic<Histogram*> histogram;
+
+  constexpr BuiltinFunc(char const* name, FuncType func)
+      : name(name),
+        func(func),
+        native(nullptr),
+        object(nullptr),
+        histogram(nullptr)
+  {
+  }
+
+  constexpr BuiltinFunc(char const* name, NativeType native)
+      : name(name),
+        func(nullptr),
+        native(native),
+        object(nullptr),
+        histogram(nullptr)
+  {
+  }
+
+  Object* call(Node* node, BF_Args args) const
+  {
+    if (Metrics::is_enabled()) {
+      return this->call_timed(node, args);
+    }
+
+    return this->call_direct(node, args);
+  }
+
+  Object* call_direct(Node* node, BF_Args args) const
+  {
+    if (this->native) {
+      return this->call_native(node, args);
+    }
+
+    return this->func(node, args);
+  }
+
+  Object* call_native(Node* node, BF_Args args) const;
+
+  //
+  // call, and record the time to builtin_seconds{name=...}
+  Object* call_timed(Node* node, BF_Args args) const;
+
+  static BuiltinFunc const* find(std::string_view name);
 
-  static std::vector<BuiltinFunc> const builtin_functions;
+  static std::span<BuiltinFunc const> const builtin_functions;
 };
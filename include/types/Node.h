@@ -9,14 +9,19 @@
 #define nd_arg_name uni_token
 #define nd_arg_type uni_nd[1]
 
+#define nd_subscript_loop uni_nd[2]  // guarded by loop (or null)
+#define nd_subscript_guard uni_index[3]
+
 #define nd_value uni_object
 #define nd_variable_name uni_token
+#define nd_variable_func uni_object  // resolved function (or null)
 
 #define nd_callfunc_functor uni_nd[0]
 
 #define nd_func_name uni_token
 #define nd_func_return_type uni_nd[1]
 #define nd_func_code uni_nd[2]
+#define nd_func_object uni_objects[3]
 
 #define nd_if_cond uni_nd[0]
 #define nd_if_true uni_nd[1]
@@ -25,6 +30,7 @@
 #define nd_for_iterator uni_nd[0]
 #define nd_for_range uni_nd[1]
 #define nd_for_loop_code uni_nd[2]
+#define nd_for_preheader uni_nd[3]  // invariants (LoopOptimizer)
 
 #define nd_return_expr uni_nd[0]
 #define nd_break_expr uni_nd[0]
@@ -33,6 +39,21 @@
 #define nd_let_type uni_nd[1]
 #define nd_let_init uni_nd[2]
 
+#define nd_induction_loop uni_nd[0]  // ND_For
+#define nd_induction_expr uni_nd[1]  // iterator * step
+#define nd_induction_step uni_nd[2]  // operand of expr
+#define nd_induction_index uni_index[3]
+
+#define nd_invariant_name uni_token  // variable in preheader
+#define nd_invariant_expr uni_nd[1]  // hoisted expression
+
+#define nd_spawn_call uni_nd[0]  // ND_Callfunc
+#define nd_await_expr uni_nd[0]
+
+#define nd_catch_name uni_token  // variable of error (or null)
+#define nd_try_code uni_nd[1]
+#define nd_catch_code uni_nd[2]
+
 enum NodeKind {
   ND_None,
   ND_SelfFunc,
@@ -99,6 +120,17 @@ enum NodeKind {
   ND_Struct,
 
   ND_Namespace,
+
+  // derived induction variable (LoopOptimizer)
+  ND_Induction,
+
+  // loop invariant computed at the first use (LoopOptimizer)
+  ND_Invariant,
+
+  ND_Spawn,
+  ND_Await,
+
+  ND_Try,
 };
 
 struct Node {
@@ -113,10 +145,32 @@ struct Node {
       Object* uni_object;
       bool uni_bval[4];
     };
+
+    Object* uni_objects[4];
+
+    size_t uni_index[4];
   };
 
   std::vector<Node*> list;
 
+  // type proven by TypeChecker (TYPE_None if unknown)
+  TypeKind expr_type;
+
+  // runtime type check of this node is redundant
+  bool type_checked;
+
+  // ND_For: the iterator doesn't escape from the body,
+  // so one counter object is reused (see LoopOptimizer)
+  bool is_unboxed;
+
+  // ND_For: the body is evaluated by batch kernels
+  // (see LoopOptimizer, Kernel.h)
+  bool is_vectorized;
+
+  // ND_For: iterations run on threads (parallel for)
+  // (see Evaluator::eval_parallel_for)
+  bool is_parallel;
+
   Node(NodeKind kind, Token* token = nullptr);
   Node(NodeKind kind, Token* token, Node* lhs, Node* rhs);
 
@@ -134,4 +188,73 @@ struct Node {
 
     return x;
   }
+
+  //
+  // call fn(Node*&) for each child node (not null)
+  template <class F>
+  void each_child(F&& fn)
+  {
+    switch (this->kind) {
+      case ND_None:
+      case ND_SelfFunc:
+      case ND_Type:
+      case ND_Argument:
+      case ND_VariableArguments:
+      case ND_True:
+      case ND_False:
+      case ND_Value:
+      case ND_EmptyList:
+      case ND_Variable:
+      case ND_Continue:
+      case ND_Struct:
+        return;
+
+      case ND_Function:
+        fn(this->nd_func_code);
+        return;
+
+      case ND_Try:
+        fn(this->nd_try_code);
+        fn(this->nd_catch_code);
+        return;
+
+      case ND_Let:
+        if (this->nd_let_init) fn(this->nd_let_init);
+        return;
+
+      case ND_Return:
+      case ND_Break:
+        if (this->nd_return_expr) fn(this->nd_return_expr);
+        return;
+
+      case ND_Induction:
+        fn(this->nd_induction_expr);
+        return;
+
+      case ND_Invariant:
+        fn(this->nd_invariant_expr);
+        return;
+
+      case ND_Subscript:
+        fn(this->nd_lhs);
+        fn(this->nd_rhs);
+        return;
+
+      case ND_For:
+        // list is inductions and guards of the loop (in body)
+        for (auto&& x : this->uni_nd) {
+          if (x) fn(x);
+        }
+
+        return;
+    }
+
+    for (auto&& x : this->uni_nd) {
+      if (x) fn(x);
+    }
+
+    for (auto&& x : this->list) {
+      fn(x);
+    }
+  }
 };
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -8,13 +12,31 @@
 struct Node;
 struct BuiltinFunc;
 
+class Channel;
+
 struct Object {
   Type type;
   size_t ref_count;
 
+  // bytes of the buffer counted by the heap
+  size_t buffer_bytes;
+
   virtual std::string to_string() const = 0;
   virtual Object* clone() const = 0;
 
+  //
+  // bytes allocated for the value out of the object
+  // (string, elements)
+  virtual size_t buffer_size() const
+  {
+    return 0;
+  }
+
+  //
+  // let the heap count the buffer again, after it grew.
+  // (see MetroGC::set_limit)
+  void update_size();
+
   virtual ~Object();
 
  protected:
@@ -64,6 +86,11 @@ struct ObjList : Object {
 
   std::string to_string() const override;
   ObjList* clone() const override;
+
+  size_t buffer_size() const override
+  {
+    return this->elements.capacity() * sizeof(Object*);
+  }
 };
 
 struct ObjString : Object {
@@ -77,6 +104,11 @@ struct ObjString : Object {
 
   std::string to_string() const override;
   ObjString* clone() const override;
+
+  size_t buffer_size() const override
+  {
+    return this->value.capacity() * sizeof(wchar_t);
+  }
 };
 
 struct ObjFloat : Object {
@@ -93,8 +125,16 @@ struct ObjRange : Object {
 
   ValueType begin;
   ValueType end;
+  ValueType step;  // not zero
 
-  ObjRange(ValueType begin, ValueType end);
+  ObjRange(ValueType begin, ValueType end, ValueType step = 1);
+
+  //
+  // value is out of range (iteration reached the end)
+  bool is_end(ValueType value) const
+  {
+    return this->step > 0 ? value >= this->end : value <= this->end;
+  }
 
   std::string to_string() const override;
   ObjRange* clone() const override;
@@ -110,9 +150,65 @@ struct ObjFunction : Object {
   std::string to_string() const override;
   ObjFunction* clone() const override;
 
+  //
+  // function objects shared by all call sites.
+  // they are not managed by GC, and never deleted.
+  static ObjFunction* new_immortal(Node* func);
   static ObjFunction* from_builtin(BuiltinFunc const& b);
 };
 
+//
+// result of the task started by spawn.
+// (see Evaluator::eval_spawn)
+// copies of future share the same state.
+struct ObjFuture : Object {
+  struct State {
+    std::atomic<bool> is_started{false};
+    std::atomic<bool> is_done{false};
+    Object* result{};
+
+    // error of the call (thrown again by await)
+    std::exception_ptr error;
+
+    // the call (set by spawn)
+    std::function<void()> task;
+
+    //
+    // run the task if not started yet.
+    // (by a thread of scheduler, or the thread awaiting it)
+    bool run()
+    {
+      if (this->is_started.exchange(true)) {
+        return false;
+      }
+
+      this->task();
+      this->task = nullptr;
+
+      return true;
+    }
+  };
+
+  std::shared_ptr<State> state;
+
+  ObjFuture();
+
+  std::string to_string() const override;
+  ObjFuture* clone() const override;
+};
+
+//
+// channel(capacity)
+// copies of channel share the same queue.
+struct ObjChannel : Object {
+  std::shared_ptr<Channel> channel;
+
+  ObjChannel(std::shared_ptr<Channel> channel);
+
+  std::string to_string() const override;
+  ObjChannel* clone() const override;
+};
+
 using ObjLong = ObjImmediate<int64_t, TYPE_Int>;
 using ObjChar = ObjImmediate<wchar_t, TYPE_Char>;
 using ObjBool = ObjImmediate<bool, TYPE_Bool>;
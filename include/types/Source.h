@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,10 @@ struct Source {
 
   std::vector<std::pair<size_t, size_t>> line_range_list;
 
+  // names made by compiler (Inliner, LoopOptimizer)
+  // tokens refer them, so they are kept with the source.
+  std::deque<std::string> names;
+
   Source();
   Source(char const* path);
 
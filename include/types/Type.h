@@ -14,7 +14,9 @@ enum TypeKind {
   TYPE_Vector,
   TYPE_Range,
   TYPE_Args,
-  TYPE_Function
+  TYPE_Function,
+  TYPE_Future,
+  TYPE_Channel
 };
 
 struct Type {
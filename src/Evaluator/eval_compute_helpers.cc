@@ -5,27 +5,28 @@
 #include "Error.h"
 #include "Utils.h"
 #include "Evaluator.h"
+#include "Kernel.h"
 
 #define nd_kind_expr_begin ND_Add
 
-template <class T> bool is_overflow(NodeKind kind, T a, T b) {
-  switch (kind) {
-  case ND_Add:
-    return (a > 0 && b > 0 && a > std::numeric_limits<T>::max() - b) ||
-           (a < 0 && b < 0 && a < std::numeric_limits<T>::min() - b);
-  case ND_Sub:
-    return (a > 0 && b < 0 && a > std::numeric_limits<T>::max() + b) ||
-           (a < 0 && b > 0 && a < std::numeric_limits<T>::min() + b);
-  case ND_Mul:
-    return (a > 0 && b > 0 && a > std::numeric_limits<T>::max() / b) ||
-           (a > 0 && b < 0 && b < std::numeric_limits<T>::min() / a) ||
-           (a < 0 && b > 0 && a < std::numeric_limits<T>::min() / b) ||
-           (a < 0 && b < 0 && b < std::numeric_limits<T>::max() / a);
-  default:
-    return false;
+namespace {
+
+//
+// divisor of integer division or modulo
+// (these are trapped by CPU, not to be computed)
+void check_divisor(Node* node, int64_t a, int64_t b)
+{
+  if (b == 0) {
+    Error(ERR_DivisionByZero, node->nd_rhs).emit().exit();
+  }
+
+  if (b == -1 && a == std::numeric_limits<int64_t>::min()) {
+    Error(ERR_ValueOutOfRange, node).emit().exit();
   }
 }
 
+}  // namespace
+
 Object* Evaluator::compute_expr(Node* node, Object* lhs, Object* rhs)
 {
 #define done goto finish
@@ -53,21 +54,34 @@ Object* Evaluator::compute_expr(Node* node, Object* lhs, Object* rhs)
       nullptr,
       nullptr,
       nullptr,
-      nullptr,
 
       // bit
       &&expr_bit_and,
       &&expr_bit_xor,
       &&expr_bit_or,
 
+      // range (compute_range)
+      nullptr,
+
       // log
       &&expr_log_and,
       &&expr_log_or,
   };
 
+  // (a slot for each kind, or the labels are shifted)
+  static_assert(sizeof(jump_table) / sizeof(void*) ==
+                ND_LogOr - nd_kind_expr_begin + 1);
+
   static std::tuple<TypeKind, TypeKind, void*> const
       jump_table_special[]{{TYPE_Int, TYPE_String, &&mul_int_str}};
 
+  //
+  // types are proven by TypeChecker
+  if (this->is_proven(node) && node->expr_type == TYPE_Int) {
+    return this->compute_int_expr(node, ((ObjLong*)lhs)->value,
+                                  ((ObjLong*)rhs)->value);
+  }
+
   this->adjust_object_type(lhs, rhs);
 
   Object* result = lhs->clone();
@@ -100,6 +114,8 @@ expr_add:
       check_overflow(ND_Add, ((ObjString*)lhs)->value.size(),
                      ((ObjString*)rhs)->value.size());
       ((ObjString*)result)->value += ((ObjString*)rhs)->value;
+      result->update_size();
+      this->check_heap(node);
       done;
   }
   invalid;
@@ -135,6 +151,8 @@ expr_mul:
 expr_div:
   switch (typekind) {
     case TYPE_Int:
+      check_divisor(node, ((ObjLong*)lhs)->value,
+                    ((ObjLong*)rhs)->value);
       ((ObjLong*)result)->value /= ((ObjLong*)rhs)->value;
       done;
 
@@ -147,6 +165,8 @@ expr_div:
 expr_mod:
   switch (typekind) {
     case TYPE_Int:
+      check_divisor(node, ((ObjLong*)lhs)->value,
+                    ((ObjLong*)rhs)->value);
       ((ObjLong*)result)->value %= ((ObjLong*)rhs)->value;
       done;
 
@@ -154,6 +174,11 @@ expr_mod:
       auto& a = ((ObjFloat*)result)->value;
       auto b = ((ObjFloat*)rhs)->value;
 
+      // (the loop below never ends)
+      if (b == 0) {
+        Error(ERR_DivisionByZero, node->nd_rhs).emit().exit();
+      }
+
       while (a >= b) {
         a -= b;
       }
@@ -207,6 +232,17 @@ mul_int_str : {
   if (count < 0)
     Error(ERR_MultiplyStringByNegative, node->nd_lhs).emit().exit();
 
+  //
+  // (allocated at once, so that the heap is checked before
+  //  making a too large string)
+  auto size = (int64_t)((ObjString*)rhs)->value.size();
+
+  check_overflow(ND_Mul, size, count);
+
+  ((ObjString*)result)->value.reserve(size * count);
+  result->update_size();
+  this->check_heap(node);
+
   for (int64_t i = 1; i < count; i++) {
     ((ObjString*)result)->value += ((ObjString*)rhs)->value;
   }
@@ -221,23 +257,73 @@ __invalid_op:
   Error(ERR_InvalidOperator, node->token).emit().exit();
 }
 
+Object* Evaluator::compute_int_expr(Node* node, int64_t a, int64_t b)
+{
+  switch (node->kind) {
+    case ND_Add:
+      check_overflow(ND_Add, a, b);
+      return new ObjLong(a + b);
+
+    case ND_Sub:
+      check_overflow(ND_Sub, a, b);
+      return new ObjLong(a - b);
+
+    case ND_Mul:
+      check_overflow(ND_Mul, a, b);
+      return new ObjLong(a * b);
+
+    case ND_Div:
+      check_divisor(node, a, b);
+      return new ObjLong(a / b);
+
+    case ND_Mod:
+      check_divisor(node, a, b);
+      return new ObjLong(a % b);
+
+    case ND_LShift:
+      return new ObjLong(a << b);
+
+    case ND_RShift:
+      return new ObjLong(a >> b);
+
+    case ND_BitAnd:
+      return new ObjLong(a & b);
+
+    case ND_BitXor:
+      return new ObjLong(a ^ b);
+
+    case ND_BitOr:
+      return new ObjLong(a | b);
+  }
+
+  Error(ERR_InvalidOperator, node->token).emit().exit();
+}
+
 Object*& Evaluator::compute_subscript(Node* node, Object* lhs,
                                       Object* index)
 {
-  if (!lhs->type.equals(TYPE_Vector)) {
-    Error(ERR_TypeMismatch, node->nd_lhs)
-        .suggest(node->nd_lhs,
-                 "expected `vector` or `tuple`, but found `" +
-                     lhs->type.to_string() + "`")
-        .emit()
-        .exit();
+  //
+  // type and range are checked on entering loop
+  if (node->nd_subscript_loop && this->is_guarded(node)) {
+    return ((ObjVector*)lhs)->elements[((ObjLong*)index)->value];
   }
 
-  if (!index->type.equals(TYPE_Int)) {
-    Error(ERR_TypeMismatch, node->nd_rhs)
-        .suggest(node->nd_rhs, "expected integer")
-        .emit()
-        .exit();
+  if (!this->is_proven(node)) {
+    if (!lhs->type.equals(TYPE_Vector)) {
+      Error(ERR_TypeMismatch, node->nd_lhs)
+          .suggest(node->nd_lhs,
+                   "expected `vector` or `tuple`, but found `" +
+                       lhs->type.to_string() + "`")
+          .emit()
+          .exit();
+    }
+
+    if (!index->type.equals(TYPE_Int)) {
+      Error(ERR_TypeMismatch, node->nd_rhs)
+          .suggest(node->nd_rhs, "expected integer")
+          .emit()
+          .exit();
+    }
   }
 
   auto ival = ((ObjLong*)index)->value;
@@ -248,3 +334,88 @@ Object*& Evaluator::compute_subscript(Node* node, Object* lhs,
 
   return ((ObjVector*)lhs)->elements[(unsigned)ival];
 }
+
+Object* Evaluator::compute_range(Node* node, Object* begin,
+                                 Object* end)
+{
+  if (!this->is_proven(node)) {
+    if (!begin->type.equals(TYPE_Int))
+      Error(ERR_TypeMismatch, node->nd_lhs)
+          .suggest(node->nd_lhs, "expected integer")
+          .emit()
+          .exit();
+
+    if (!end->type.equals(TYPE_Int))
+      Error(ERR_TypeMismatch, node->nd_rhs)
+          .suggest(node->nd_rhs, "expected integer")
+          .emit()
+          .exit();
+  }
+
+  return new ObjRange(((ObjLong*)begin)->value,
+                      ((ObjLong*)end)->value);
+}
+
+//
+// compare lhs and rhs with the operator of item.
+// node is the top of comparison chain. (used for error)
+bool Evaluator::compute_compare(Node* node, Node* item, Object*& lhs,
+                                Object*& rhs)
+{
+  if (!this->is_proven(item)) {
+    this->adjust_object_type(lhs, rhs);
+
+    if (!lhs->type.equals(rhs->type)) {
+      Error(ERR_TypeMismatch, node).emit().exit();
+    }
+  }
+
+  auto result = false;
+
+  switch (item->kind) {
+    case ND_Bigger:
+      switch (lhs->type.kind) {
+        case TYPE_Int:
+          result = ((ObjLong*)lhs)->value > ((ObjLong*)rhs)->value;
+          break;
+
+        case TYPE_Float:
+          result = ((ObjFloat*)lhs)->value > ((ObjFloat*)rhs)->value;
+          break;
+      }
+      break;
+
+    case ND_BiggerOrEqual:
+      switch (lhs->type.kind) {
+        case TYPE_Int:
+          result = ((ObjLong*)lhs)->value >= ((ObjLong*)rhs)->value;
+          break;
+
+        case TYPE_Float:
+          result =
+              ((ObjFloat*)lhs)->value >= ((ObjFloat*)rhs)->value;
+          break;
+      }
+      break;
+
+    case ND_Equal:
+    case ND_NotEqual:
+      switch (lhs->type.kind) {
+        case TYPE_Int:
+          result = ((ObjLong*)lhs)->value == ((ObjLong*)rhs)->value;
+          break;
+
+        case TYPE_Float:
+          result =
+              ((ObjFloat*)lhs)->value == ((ObjFloat*)rhs)->value;
+          break;
+      }
+
+      if (item->kind == ND_NotEqual)
+        result ^= 1;
+
+      break;
+  }
+
+  return result;
+}
@@ -0,0 +1,533 @@
+#include <algorithm>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "Evaluator.h"
+#include "Kernel.h"
+#include "ThreadPool.h"
+
+struct Evaluator::Batch {
+  TypeKind kind;  // TYPE_Int or TYPE_Float
+
+  int64_t ints[Kernel::batch_size];
+  float floats[Kernel::batch_size];
+
+  //
+  // int --> float  (same as adjust_object_type)
+  void to_float(size_t count)
+  {
+    for (size_t i = 0; i < count; i++) {
+      this->floats[i] = (float)this->ints[i];
+    }
+
+    this->kind = TYPE_Float;
+  }
+};
+
+namespace {
+
+//
+// batches evaluated at once by each thread
+constexpr size_t batches_per_thread = 4;
+
+//
+// statement of vectorized loop:
+//   v[i] = expr            (dest)
+//   var = var <op> expr    (reduction)
+struct Statement {
+  Node* expr;
+  ObjVector* dest;
+
+  NodeKind op;
+  Object** var;
+};
+
+struct Accumulator {
+  TypeKind kind;
+  int64_t ival;
+  float fval;
+};
+
+//
+// reduction of integers in a batch
+//  add: sum, and the range of prefix sums
+//  bit: result of operator
+struct Partial {
+  __int128 value;
+  __int128 low;
+  __int128 high;
+};
+
+Partial reduce_batch(NodeKind op, int64_t const* values, size_t count)
+{
+  Partial p{op == ND_BitAnd ? -1 : 0, 0, 0};
+
+  for (size_t i = 0; i < count; i++) {
+    switch (op) {
+      case ND_Add:
+        p.value += values[i];
+        p.low = i == 0 ? p.value : std::min(p.low, p.value);
+        p.high = i == 0 ? p.value : std::max(p.high, p.value);
+        break;
+
+      case ND_BitAnd:
+        p.value &= values[i];
+        break;
+
+      case ND_BitXor:
+        p.value ^= values[i];
+        break;
+
+      case ND_BitOr:
+        p.value |= values[i];
+        break;
+    }
+  }
+
+  return p;
+}
+
+//
+// add the batch to accumulator, in order of iterations.
+// false if it can't be computed as the sequential evaluation.
+bool fold(Accumulator& acc, NodeKind op, TypeKind kind,
+          int64_t const* ints, float const* floats, Partial const& p,
+          size_t count)
+{
+  if (acc.kind == TYPE_Int && kind == TYPE_Int) {
+    switch (op) {
+      case ND_Add:
+        if (acc.ival + p.low < std::numeric_limits<int64_t>::min() ||
+            acc.ival + p.high > std::numeric_limits<int64_t>::max()) {
+          return false;
+        }
+
+        acc.ival += (int64_t)p.value;
+        break;
+
+      case ND_BitAnd:
+        acc.ival &= (int64_t)p.value;
+        break;
+
+      case ND_BitXor:
+        acc.ival ^= (int64_t)p.value;
+        break;
+
+      case ND_BitOr:
+        acc.ival |= (int64_t)p.value;
+        break;
+    }
+
+    return true;
+  }
+
+  //
+  // int, float --> float, float
+  // (addition of float is not associative, so one by one)
+  if (op != ND_Add) {
+    return false;
+  }
+
+  if (acc.kind == TYPE_Int) {
+    acc.fval = (float)acc.ival;
+    acc.kind = TYPE_Float;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    auto v = kind == TYPE_Int ? (float)ints[i] : floats[i];
+
+    if (is_overflow(ND_Add, acc.fval, v)) {
+      return false;
+    }
+
+    acc.fval += v;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+//
+// the body is a list of "v[i] = expr" and "var = var <op> expr".
+// iterations are independent, so the batches are computed in
+// parallel (if thread pool is enabled), in waves of batches.
+//
+// a wave is stored only up to the first batch which can't be
+// computed by kernels, and the rest of loop is evaluated by the
+// normal loop from there. so any error is reported by eval().
+bool Evaluator::eval_kernel(Node* node, LoopContext& loopContext,
+                            Object* target, int64_t& counter)
+{
+  auto is_range = target->type.kind == TYPE_Range;
+
+  //
+  // all vectors are in bounds of the range
+  for (auto&& x : node->list) {
+    if (x->kind == ND_Subscript &&
+        !loopContext.guards[x->nd_subscript_guard]) {
+      return false;
+    }
+  }
+
+  auto get_vector = [this](Node* subscript) {
+    return (ObjVector*)*this->lookup_var(
+        subscript->nd_lhs->token->str);
+  };
+
+  std::vector<Statement> stmts;
+  std::vector<Accumulator> accums;
+
+  //
+  // statement can't read the vector written by previous ones,
+  // since the results are stored after all of them.
+  std::vector<ObjVector*> written;
+
+  auto reads_written = [&](auto&& self, Node* x) -> bool {
+    if (x->kind == ND_Subscript &&
+        std::find(written.begin(), written.end(), get_vector(x)) !=
+            written.end()) {
+      return true;
+    }
+
+    auto found = false;
+
+    x->each_child([&](Node*& y) { found = found || self(self, y); });
+
+    return found;
+  };
+
+  for (auto&& x : node->nd_for_loop_code->list) {
+    if (x->kind != ND_Assign) {
+      continue;
+    }
+
+    auto& st = stmts.emplace_back(
+        Statement{x->nd_rhs, nullptr, ND_None, nullptr});
+
+    auto& acc = accums.emplace_back(Accumulator{TYPE_None, 0, 0});
+
+    if (x->nd_lhs->kind == ND_Subscript) {
+      st.dest = get_vector(x->nd_lhs);
+    }
+    else {
+      st.expr = x->nd_rhs->nd_rhs;
+      st.op = x->nd_rhs->kind;
+      st.var = this->lookup_var(x->nd_lhs->nd_variable_name->str);
+
+      if (!st.var || !*st.var) {
+        return false;
+      }
+
+      acc.kind = (*st.var)->type.kind;
+
+      if (acc.kind == TYPE_Int)
+        acc.ival = ((ObjLong*)*st.var)->value;
+      else if (acc.kind == TYPE_Float)
+        acc.fval = ((ObjFloat*)*st.var)->value;
+      else
+        return false;
+    }
+
+    if (reads_written(reads_written, st.expr)) {
+      return false;
+    }
+
+    if (st.dest) {
+      written.emplace_back(st.dest);
+    }
+  }
+
+  auto const S = stmts.size();
+  auto const step = is_range ? ((ObjRange*)target)->step : 1;
+
+  uint64_t remain;
+
+  if (is_range) {
+    auto end = ((ObjRange*)target)->end;
+
+    // (the distance may not fit in int64_t)
+    auto distance = step > 0 ? (uint64_t)end - (uint64_t)counter
+                             : (uint64_t)counter - (uint64_t)end;
+
+    auto span = step > 0 ? (uint64_t)step : -(uint64_t)step;
+
+    remain = distance / span + (distance % span != 0);
+  }
+  else {
+    remain = ((ObjVector*)target)->elements.size() - counter;
+  }
+
+  auto run = [this](size_t count,
+                    std::function<void(size_t)> const& fn) {
+    if (this->pool && count > 1) {
+      this->pool->run(count, fn);
+      return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      fn(i);
+    }
+  };
+
+  auto const wave =
+      this->pool ? this->pool->size() * batches_per_thread : 1;
+
+  std::vector<Batch> iters(wave);
+  std::vector<Batch> results(wave * S);
+  std::vector<Partial> partials(wave * S);
+  std::vector<char> is_done(wave);
+
+  auto is_finished = true;
+  auto is_folded = false;
+
+  while (remain && is_finished) {
+    auto count =
+        std::min<uint64_t>(remain, wave * Kernel::batch_size);
+    auto batches =
+        (count + Kernel::batch_size - 1) / Kernel::batch_size;
+
+    // (iterations of the wave at once)
+    this->count_step(node->nd_for_range, count);
+
+    auto size_of = [count](size_t b) {
+      return std::min<size_t>(count - b * Kernel::batch_size,
+                              Kernel::batch_size);
+    };
+
+    //
+    // compute all batches of wave
+    run(batches, [&](size_t b) {
+      auto n = size_of(b);
+      auto& iter = iters[b];
+
+      is_done[b] = false;
+
+      if (is_range) {
+        iter.kind = TYPE_Int;
+
+        for (size_t i = 0; i < n; i++) {
+          iter.ints[i] = (int64_t)((uint64_t)counter +
+                                   (b * Kernel::batch_size + i) *
+                                       (uint64_t)step);
+        }
+      }
+      else {
+        // (elements of vector must have same type)
+        auto elements = ((ObjVector*)target)->elements.data() +
+                        counter + b * Kernel::batch_size;
+
+        iter.kind = elements[0]->type.kind;
+
+        for (size_t i = 0; i < n; i++) {
+          if (elements[i]->type.kind != iter.kind) return;
+
+          if (iter.kind == TYPE_Int)
+            iter.ints[i] = ((ObjLong*)elements[i])->value;
+          else if (iter.kind == TYPE_Float)
+            iter.floats[i] = ((ObjFloat*)elements[i])->value;
+          else
+            return;
+        }
+      }
+
+      for (size_t s = 0; s < S; s++) {
+        auto& result = results[b * S + s];
+
+        if (!this->eval_batch(stmts[s].expr, node, result, iter, n)) {
+          return;
+        }
+
+        if (stmts[s].var && result.kind == TYPE_Int) {
+          partials[b * S + s] =
+              reduce_batch(stmts[s].op, result.ints, n);
+        }
+      }
+
+      is_done[b] = true;
+    });
+
+    //
+    // reductions in order of batches
+    size_t done = 0;
+
+    for (auto next = accums; done < batches; done++) {
+      if (!is_done[done]) {
+        break;
+      }
+
+      auto ok = true;
+
+      for (size_t s = 0; ok && s < S; s++) {
+        if (stmts[s].var) {
+          auto& result = results[done * S + s];
+
+          ok = fold(next[s], stmts[s].op, result.kind, result.ints,
+                    result.floats, partials[done * S + s],
+                    size_of(done));
+        }
+      }
+
+      if (!ok) {
+        break;
+      }
+
+      accums = next;
+      is_folded = true;
+    }
+
+    //
+    // store results
+    run(done, [&](size_t b) {
+      for (size_t s = 0; s < S; s++) {
+        if (!stmts[s].dest) {
+          continue;
+        }
+
+        auto& elements = stmts[s].dest->elements;
+        auto& result = results[b * S + s];
+
+        for (size_t i = 0; i < size_of(b); i++) {
+          if (result.kind == TYPE_Int)
+            elements[iters[b].ints[i]] = new ObjLong(result.ints[i]);
+          else
+            elements[iters[b].ints[i]] =
+                new ObjFloat(result.floats[i]);
+        }
+      }
+    });
+
+    auto finished =
+        done == batches ? count : done * Kernel::batch_size;
+
+    is_finished = done == batches;
+
+    if ((remain -= finished) == 0) {
+      break;
+    }
+
+    counter =
+        (int64_t)((uint64_t)counter + finished * (uint64_t)step);
+
+    this->step_inductions(loopContext, finished);
+  }
+
+  if (is_folded) {
+    for (size_t s = 0; s < S; s++) {
+      if (!stmts[s].var) {
+        continue;
+      }
+
+      if (accums[s].kind == TYPE_Int)
+        *stmts[s].var = new ObjLong(accums[s].ival);
+      else
+        *stmts[s].var = new ObjFloat(accums[s].fval);
+    }
+  }
+
+  return is_finished;
+}
+
+bool Evaluator::eval_batch(Node* node, Node* loop, Batch& batch,
+                           Batch const& iter, size_t count)
+{
+  switch (node->kind) {
+    case ND_Value:
+    case ND_Variable: {
+      if (node->kind == ND_Variable &&
+          node->nd_variable_name->str ==
+              loop->nd_for_iterator->nd_variable_name->str) {
+        batch.kind = iter.kind;
+
+        if (iter.kind == TYPE_Int)
+          std::copy_n(iter.ints, count, batch.ints);
+        else
+          std::copy_n(iter.floats, count, batch.floats);
+
+        return true;
+      }
+
+      auto value = node->nd_value;
+
+      if (node->kind == ND_Variable) {
+        auto p = this->lookup_var(node->nd_variable_name->str);
+
+        if (!p || !*p) {
+          return false;
+        }
+
+        value = *p;
+      }
+
+      batch.kind = value->type.kind;
+
+      if (batch.kind == TYPE_Int)
+        std::fill_n(batch.ints, count, ((ObjLong*)value)->value);
+      else if (batch.kind == TYPE_Float)
+        std::fill_n(batch.floats, count, ((ObjFloat*)value)->value);
+      else
+        return false;
+
+      return true;
+    }
+
+    case ND_Induction:
+      return this->eval_batch(node->nd_induction_expr, loop, batch,
+                              iter, count);
+
+    case ND_Invariant:
+      return this->eval_batch(node->nd_invariant_expr, loop, batch,
+                              iter, count);
+
+    //
+    // elements must have same type.
+    // (subscript is guarded only in range loop,
+    //  so the iterators are indices)
+    case ND_Subscript: {
+      auto index = iter.ints;
+
+      auto& elements =
+          ((ObjVector*)*this->lookup_var(node->nd_lhs->token->str))
+              ->elements;
+
+      batch.kind = elements[index[0]]->type.kind;
+
+      for (size_t i = 0; i < count; i++) {
+        auto x = elements[index[i]];
+
+        if (x->type.kind != batch.kind) {
+          return false;
+        }
+
+        if (batch.kind == TYPE_Int)
+          batch.ints[i] = ((ObjLong*)x)->value;
+        else if (batch.kind == TYPE_Float)
+          batch.floats[i] = ((ObjFloat*)x)->value;
+        else
+          return false;
+      }
+
+      return true;
+    }
+  }
+
+  Batch rhs;
+
+  if (!this->eval_batch(node->nd_lhs, loop, batch, iter, count) ||
+      !this->eval_batch(node->nd_rhs, loop, rhs, iter, count)) {
+    return false;
+  }
+
+  if (batch.kind != rhs.kind) {
+    (batch.kind == TYPE_Int ? batch : rhs).to_float(count);
+  }
+
+  if (batch.kind == TYPE_Int) {
+    return Kernel::compute(node->kind, batch.ints, batch.ints,
+                           rhs.ints, count);
+  }
+
+  return Kernel::compute(node->kind, batch.floats, batch.floats,
+                         rhs.floats, count);
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "Error.h"
+#include "Utils.h"
+#include "Evaluator.h"
+#include "ThreadPool.h"
+#include "Scheduler.h"
+
+//
+// ------------------------------------------------
+//  parallel for
+//
+//  parallel for x in range { ... }
+//
+//  each thread has a worker (Evaluator) which has
+//  copies of the scopes and variables of parent.
+//  the variables are shared objects, so the body can
+//  write elements of vector, but can't assign variables
+//  outside of the loop. variables defined by let in the
+//  body are local to the iteration.
+//
+//  the body must not resize vectors shared between
+//  iterations, and break / return are not allowed.
+// ------------------------------------------------
+
+namespace {
+
+//
+// chunks per thread in the first split.
+// smaller chunks are balanced better by stealing,
+// but the parts are locked more often.
+constexpr size_t chunks_per_thread = 16;
+
+//
+// count of values in range
+size_t get_iteration_count(ObjRange* range)
+{
+  if (range->is_end(range->begin)) {
+    return 0;
+  }
+
+  // (no overflow in unsigned)
+  if (range->step > 0) {
+    return ((uint64_t)range->end - (uint64_t)range->begin - 1) /
+               (uint64_t)range->step +
+           1;
+  }
+
+  return ((uint64_t)range->begin - (uint64_t)range->end - 1) /
+             -(uint64_t)range->step +
+         1;
+}
+
+}  // namespace
+
+Evaluator::Evaluator(Evaluator* parent, Node* loop)
+    : globals(nullptr),
+      max_frames(parent->max_frames),
+      steps(0),
+      next_check(parent->next_check),
+      max_steps(parent->max_steps),
+      own_total_steps(0),
+      total_steps(parent->total_steps),
+      deadline(parent->deadline),
+      is_unchecked(parent->is_unchecked),
+      scheduler(parent->scheduler),
+      parent(parent),
+      _gc(parent->_gc)
+{
+  for (size_t i = 0; i < parent->scope_stack.size(); i++) {
+    this->scope_stack.push(parent->scope_stack[i]);
+  }
+
+  for (size_t i = 0; i < parent->var_stack.size(); i++) {
+    this->var_stack.push(parent->var_stack[i]);
+  }
+
+  this->shared_vars = this->var_stack.size();
+
+  // (checked at the first step, if the run has a budget)
+  if (this->next_check != std::numeric_limits<uint64_t>::max()) {
+    this->next_check = 0;
+  }
+
+  //
+  // scope of loop has only the iterator
+  // (call stack is empty, so return is an error)
+  if (loop) {
+    this->loop_stack.push(loop, this->enter_scope(loop));
+  }
+}
+
+Object* Evaluator::eval_parallel_for(Node* node)
+{
+  auto target = this->eval(node->nd_for_range);
+
+  size_t count = 0;
+
+  switch (target->type.kind) {
+    case TYPE_Range:
+      count = get_iteration_count((ObjRange*)target);
+      break;
+
+    case TYPE_Vector:
+      count = ((ObjVector*)target)->elements.size();
+      break;
+
+    default:
+      Error(ERR_TypeMismatch, node->nd_for_range)
+          .suggest(node->nd_for_range,
+                   "`" + target->type.to_string() +
+                       "` is not iterable")
+          .emit()
+          .exit();
+  }
+
+  auto const threads = this->pool ? this->pool->size() : 1;
+
+  //
+  // a worker is created by the thread at the first chunk
+  std::vector<std::unique_ptr<Evaluator>> workers(threads);
+
+  auto fn = [&](size_t id, size_t begin, size_t end) {
+    auto& worker = workers[id];
+
+    if (!worker) {
+      worker.reset(new Evaluator(this, node));
+    }
+
+    worker->eval_iterations(node, target, begin, end);
+  };
+
+  if (threads > 1 && count > 1) {
+    this->pool->run_split(count,
+                          count / (threads * chunks_per_thread), fn);
+  }
+  else if (count != 0) {
+    fn(0, 0, count);
+  }
+
+  return new ObjNone;
+}
+
+void Evaluator::eval_iterations(Node* node, Object* target,
+                                size_t begin, size_t end)
+{
+  auto& scope = this->get_cur_scope();
+  auto name = node->nd_for_iterator->nd_variable_name->str;
+
+  for (auto i = begin; i < end; i++) {
+    this->count_step(node->nd_for_range);
+
+    Object* value;
+
+    if (target->type.kind == TYPE_Range) {
+      auto R = (ObjRange*)target;
+
+      value = new ObjLong(
+          (int64_t)((uint64_t)R->begin + i * (uint64_t)R->step));
+    }
+    else {
+      value = ((ObjVector*)target)->elements[i];
+    }
+
+    // the iterator holds a reference (released below)
+    std::atomic_ref(value->ref_count)++;
+
+    this->define_var(scope, value, name);
+
+    this->eval_scope(scope, node->nd_for_loop_code);
+
+    //
+    // variables of body are local to the iteration
+    this->release_variables(scope);
+  }
+}
+
+void Evaluator::check_shared_var(Node* node)
+{
+  for (auto i = this->var_stack.size(); i-- > 0;) {
+    if (this->var_stack[i].name != node->token->str) {
+      continue;
+    }
+
+    if (i < this->shared_vars) {
+      Error(ERR_AssignToSharedVariable, node->token).emit().exit();
+    }
+
+    break;
+  }
+}
@@ -0,0 +1,806 @@
+#include <cassert>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "types/BuiltinFunc.h"
+#include "Error.h"
+#include "Utils.h"
+#include "Evaluator.h"
+
+//
+// ------------------------------------------------
+//  stackless evaluation
+//
+//  every node in progress has a Frame on this->frames,
+//  and the results of child nodes are pushed to this->values.
+//  a frame pushes exactly one value when it is finished.
+//
+//  nodes that never evaluate a user function are given to
+//  eval() directly.
+// ------------------------------------------------
+
+Evaluator::Frame::Frame(Node* node, size_t base)
+    : node(node),
+      state(0),
+      index(0),
+      base(base),
+      value(nullptr),
+      counter(0),
+      slot(nullptr),
+      is_tail(false)
+{
+}
+
+Object* Evaluator::eval_stackless(Node* node)
+{
+  auto const frame_base = this->frames.size();
+
+  this->push_frame(node);
+
+  while (this->frames.size() > frame_base) {
+    try {
+      this->step();
+    }
+    catch (ScriptError const& err) {
+      if (!this->catch_error_frame(frame_base, err)) {
+        throw;
+      }
+    }
+  }
+
+  return this->pop_value();
+}
+
+void Evaluator::set_max_frames(size_t count)
+{
+  this->max_frames = count;
+}
+
+void Evaluator::push_frame(Node* node)
+{
+  if (this->frames.size() >= this->max_frames) {
+    Error(ERR_StackOverflow, node).emit().exit();
+  }
+
+  this->frames.emplace_back(node, this->values.size());
+}
+
+void Evaluator::finish_frame(Object* value)
+{
+  this->values.resize(this->frames.back().base);
+  this->frames.pop_back();
+
+  this->values.emplace_back(value);
+}
+
+Object* Evaluator::pop_value()
+{
+  auto value = this->values.back();
+
+  this->values.pop_back();
+
+  return value;
+}
+
+//
+// remove the top frame without result
+// (leave scope or loop if the frame has entered it)
+void Evaluator::unwind_frame()
+{
+  auto& F = this->frames.back();
+
+  switch (F.node ? F.node->kind : ND_None) {
+    case ND_Scope:
+      if (F.state >= 1) this->leave_scope();
+      break;
+
+    case ND_For:
+      if (F.state >= 1) {
+        this->loop_stack.pop();
+        this->leave_scope();
+      }
+      break;
+
+    case ND_Try:
+      if (F.state == 1) this->pop_try(this->try_stack.size() - 1);
+      if (F.state == 3) this->leave_scope();
+      break;
+  }
+
+  this->values.resize(F.base);
+  this->frames.pop_back();
+}
+
+//
+// remove frames until the function running now
+void Evaluator::unwind_to_call()
+{
+  while (true) {
+    auto& F = this->frames.back();
+
+    if (F.node && F.node->kind == ND_Callfunc && F.state == 3) {
+      break;
+    }
+
+    this->unwind_frame();
+  }
+}
+
+//
+// remove frames until the loop running now.
+// don't go beyond the function.
+void Evaluator::unwind_to_loop()
+{
+  auto loop = this->get_cur_loop_context().node;
+
+  for (auto i = this->frames.size(); i-- > 0;) {
+    auto& F = this->frames[i];
+
+    if (F.node == loop && F.state == 3) {
+      while (this->frames.size() > i + 1) {
+        this->unwind_frame();
+      }
+
+      this->frames.back().state = 4;
+      return;
+    }
+
+    if (F.node && F.node->kind == ND_Callfunc && F.state == 3) {
+      break;
+    }
+  }
+
+  this->finish_frame(new ObjNone);
+}
+
+void Evaluator::step()
+{
+  auto& F = this->frames.back();
+  auto node = F.node;
+
+  if (!node) {
+    this->finish_frame(new ObjNone);
+    return;
+  }
+
+  switch (node->kind) {
+    case ND_List: {
+      if (F.index < node->list.size()) {
+        this->push_frame(node->list[F.index++]);
+        return;
+      }
+
+      auto ret = new ObjVector();
+
+      ret->elements.assign(this->values.begin() + F.base,
+                           this->values.end());
+
+      ret->update_size();
+
+      this->finish_frame(ret);
+      return;
+    }
+
+    case ND_Subscript:
+    case ND_Range:
+    case ND_Add ... ND_RShift:
+    case ND_BitAnd ... ND_BitOr:
+    case ND_LogAnd:
+    case ND_LogOr: {
+      if (F.state < 2) {
+        this->push_frame(F.state++ == 0 ? node->nd_lhs
+                                        : node->nd_rhs);
+        return;
+      }
+
+      auto lhs = this->values[F.base];
+      auto rhs = this->values[F.base + 1];
+
+      if (node->kind == ND_Subscript)
+        this->finish_frame(this->compute_subscript(node, lhs, rhs));
+      else if (node->kind == ND_Range)
+        this->finish_frame(this->compute_range(node, lhs, rhs));
+      else
+        this->finish_frame(this->compute_expr(node, lhs, rhs));
+
+      return;
+    }
+
+    //
+    // comparison chain
+    //  values = [lhs, rhs]
+    case ND_Bigger ... ND_NotEqual: {
+      size_t count = 1;
+      Node* x = node->nd_lhs;
+
+      for (; x->kind >= ND_Bigger && x->kind <= ND_NotEqual;
+           x = x->nd_lhs) {
+        count++;
+      }
+
+      if (F.state == 0) {
+        F.state = 1;
+        this->push_frame(x);
+        return;
+      }
+
+      // get (F.index)th item from the bottom
+      auto item = node;
+
+      for (auto i = F.index + 1; i < count; i++) {
+        item = item->nd_lhs;
+      }
+
+      if (F.state == 1) {
+        F.state = 2;
+        this->push_frame(item->nd_rhs);
+        return;
+      }
+
+      auto lhs = this->values[F.base];
+      auto rhs = this->values[F.base + 1];
+
+      if (!this->compute_compare(node, item, lhs, rhs)) {
+        this->finish_frame(new ObjBool(false));
+        return;
+      }
+
+      if (++F.index == count) {
+        this->finish_frame(new ObjBool(true));
+        return;
+      }
+
+      this->values.resize(F.base);
+      this->values.emplace_back(rhs);
+
+      F.state = 1;
+      return;
+    }
+
+    //
+    // 関数呼び出し
+    //  values = [functor, args...]
+    case ND_Callfunc: {
+      switch (F.state) {
+        case 0:
+          F.state = 1;
+          this->push_frame(node->nd_callfunc_functor);
+          return;
+
+        case 1: {
+          auto functor = (ObjFunction*)this->values[F.base];
+
+          // 関数オブジェクトでないならエラー
+          if (!functor->type.equals(TYPE_Function)) {
+            Error(ERR_TypeMismatch, node->token).emit().exit();
+          }
+
+          F.state = 2;
+          return;
+        }
+
+        case 2: {
+          if (F.index < node->list.size()) {
+            this->push_frame(node->list[F.index++]);
+            return;
+          }
+
+          auto functor = (ObjFunction*)this->values[F.base];
+          auto args = this->values.data() + F.base + 1;
+          auto argc = this->values.size() - F.base - 1;
+
+          // 組み込み
+          if (functor->is_builtin) {
+            auto result = functor->builtin->call(node, {args, argc});
+
+            this->check_heap(node);
+
+            this->finish_frame(result);
+            return;
+          }
+
+          this->count_step(node);
+
+          //
+          // tail call:
+          // let the frame of current function jump into callee
+          if (F.is_tail &&
+              this->get_cur_call_stack().can_tail_call(
+                  functor->func)) {
+            auto& cs = this->get_cur_call_stack();
+
+            this->tail_args.assign(args, args + argc);
+            cs.tail_func = functor;
+            cs.tail_node = node;
+            cs.is_returned = true;
+
+            this->unwind_to_call();
+            return;
+          }
+
+          auto callee = functor->func;
+
+          auto& scope = this->enter_scope(callee);
+
+          this->call_stack.push(callee);
+          this->bind_args(node, scope, callee, args, argc);
+
+          this->values.resize(F.base);
+
+          F.state = 3;
+          this->push_frame(callee->nd_func_code);
+          return;
+        }
+
+        //
+        // returned from callee
+        case 3: {
+          auto& cs = this->get_cur_call_stack();
+
+          this->values.resize(F.base);
+
+          assert(cs.is_returned);
+
+          if (cs.tail_func) {
+            auto& scope = this->get_cur_scope();
+            auto callee = cs.tail_func->func;
+
+            this->release_variables(scope);
+
+            scope.node = callee;
+            cs.jump_to(callee);
+
+            this->bind_args(cs.tail_node, scope, callee,
+                            this->tail_args.data(),
+                            this->tail_args.size());
+
+            this->push_frame(callee->nd_func_code);
+            return;
+          }
+
+          auto result = cs.result;
+
+          this->check_return_type(cs.typed_func, result);
+
+          this->leave_scope();
+
+          // remove call stack
+          this->call_stack.pop();
+
+          this->finish_frame(result);
+          return;
+        }
+      }
+
+      break;
+    }
+
+    case ND_If: {
+      if (F.state == 0) {
+        F.state = 1;
+        this->push_frame(node->nd_if_cond);
+        return;
+      }
+
+      auto cond = this->values[F.base];
+
+      if (!this->is_proven(node) && !cond->type.equals(TYPE_Bool)) {
+        Error(ERR_TypeMismatch, node->nd_if_cond)
+            .suggest(node->nd_if_cond, "condition must boolean")
+            .emit()
+            .exit();
+      }
+
+      auto branch = ((ObjBool*)cond)->value ? node->nd_if_true
+                                            : node->nd_if_false;
+
+      auto is_tail = F.is_tail;
+
+      // replace this frame with the branch
+      this->values.resize(F.base);
+      this->frames.pop_back();
+
+      this->push_frame(branch);
+      this->frames.back().is_tail = is_tail;
+
+      return;
+    }
+
+    //
+    // for - loop
+    //  state 1: evaluated range
+    //  state 2: head of iteration
+    //  state 3: running loop code
+    //  state 4: go to next iteration
+    case ND_For: {
+      // (the body runs on workers by eval())
+      if (node->is_parallel) {
+        this->finish_frame(this->eval_parallel_for(node));
+        return;
+      }
+
+      switch (F.state) {
+        case 0: {
+          auto& scope = this->enter_scope(node);
+
+          this->loop_stack.push(node, scope);
+
+          F.state = 1;
+          this->push_frame(node->nd_for_range);
+          return;
+        }
+
+        case 1: {
+          auto& scope = this->get_cur_scope();
+
+          F.value = this->pop_value();
+
+          Object** p_iter_obj{};
+
+          if (node->nd_for_iterator->kind == ND_Variable) {
+            auto& V = this->define_var(
+                scope, nullptr,
+                node->nd_for_iterator->nd_variable_name->str);
+
+            p_iter_obj = F.slot = &V.value;
+          }
+          else {
+            p_iter_obj = &this->eval_lvalue(node->nd_for_iterator);
+          }
+
+          switch (F.value->type.kind) {
+            case TYPE_Range:
+              F.counter = ((ObjRange*)F.value)->begin;
+
+              // reused counter
+              if (node->is_unboxed)
+                *p_iter_obj = new ObjLong(F.counter);
+
+              if (auto R = (ObjRange*)F.value;
+                  !R->is_end(F.counter)) {
+                auto& loopContext = this->get_cur_loop_context();
+
+                this->enter_loop_body(node, loopContext, R);
+
+                if (node->is_vectorized &&
+                    this->eval_kernel(node, loopContext, R,
+                                      F.counter))
+                  F.counter = R->end;
+              }
+
+              break;
+
+            case TYPE_Vector:
+              if (auto V = (ObjVector*)F.value;
+                  !V->elements.empty()) {
+                auto& loopContext = this->get_cur_loop_context();
+
+                *p_iter_obj = V->elements[0];
+
+                this->enter_loop_body(node, loopContext, V);
+
+                if (node->is_vectorized &&
+                    this->eval_kernel(node, loopContext, V,
+                                      F.counter))
+                  F.counter = V->elements.size();
+              }
+
+              break;
+
+            // (received by state 2)
+            case TYPE_Channel:
+              break;
+
+            default:
+              Error(ERR_TypeMismatch, node->nd_for_range)
+                  .suggest(node->nd_for_range,
+                           "`" + F.value->type.to_string() +
+                               "` is not iterable")
+                  .emit()
+                  .exit();
+          }
+
+          F.state = 2;
+          return;
+        }
+
+        case 2: {
+          auto& loopContext = this->get_cur_loop_context();
+
+          auto kind = F.value->type.kind;
+
+          Object* received{};
+
+          auto is_end =
+              loopContext.is_breaked ||
+              (kind == TYPE_Range
+                   ? ((ObjRange*)F.value)->is_end(F.counter)
+               : kind == TYPE_Vector
+                   ? (size_t)F.counter >=
+                         ((ObjVector*)F.value)->elements.size()
+                   : !this->recv_iterator(node, (ObjChannel*)F.value,
+                                          received));
+
+          if (is_end) {
+            auto result = loopContext.result;
+
+            this->loop_stack.pop();
+            this->leave_scope();
+
+            this->finish_frame(result ? result : new ObjNone);
+            return;
+          }
+
+          this->count_step(node->nd_for_range);
+
+          auto& slot =
+              F.slot ? *F.slot
+                     : this->eval_lvalue(node->nd_for_iterator);
+
+          if (received) {
+            if (F.counter == 0)
+              this->enter_loop_body(node, loopContext, F.value);
+
+            slot = received;
+          }
+          else if (kind != TYPE_Range)
+            slot = ((ObjVector*)F.value)->elements[F.counter];
+          else if (node->is_unboxed)
+            ((ObjLong*)slot)->value = F.counter;
+          else
+            slot = new ObjLong(F.counter);
+
+          this->get_cur_scope().is_skipped = false;
+
+          F.index = 0;
+          F.state = 3;
+          return;
+        }
+
+        case 3: {
+          auto code = node->nd_for_loop_code;
+
+          this->values.resize(F.base);
+
+          if (F.index < code->list.size() &&
+              !this->get_cur_scope().is_skipped) {
+            this->push_frame(code->list[F.index++]);
+            return;
+          }
+
+          F.state = 4;
+          return;
+        }
+
+        case 4:
+          this->values.resize(F.base);
+
+          this->step_inductions(this->get_cur_loop_context());
+
+          if (F.value->type.kind != TYPE_Range)
+            F.counter++;
+          else if (auto R = (ObjRange*)F.value;
+                   __builtin_add_overflow(F.counter, R->step,
+                                          &F.counter))
+            F.counter = R->end;
+
+          F.state = 2;
+          return;
+      }
+
+      break;
+    }
+
+    //
+    // try - catch
+    //  state 1: in try block
+    //  state 2: error is caught (F.value, see catch_error_frame)
+    //  state 3: in catch block
+    case ND_Try: {
+      switch (F.state) {
+        case 0:
+          F.state = 1;
+
+          this->push_try(node);
+          this->push_frame(node->nd_try_code);
+          return;
+
+        case 1:
+          this->pop_try(this->try_stack.size() - 1);
+          this->finish_frame(this->values[F.base]);
+          return;
+
+        case 2: {
+          auto& scope = this->enter_scope(node);
+
+          if (node->nd_catch_name) {
+            this->define_var(scope, F.value,
+                             node->nd_catch_name->str);
+          }
+
+          F.state = 3;
+
+          this->push_frame(node->nd_catch_code);
+          return;
+        }
+
+        case 3: {
+          auto result = this->values[F.base];
+
+          this->leave_scope();
+          this->finish_frame(result);
+          return;
+        }
+      }
+
+      break;
+    }
+
+    case ND_Return: {
+      if (this->call_stack.empty())
+        Error(ERR_CannotUseReturnHere, node).emit().exit();
+
+      auto expr = node->nd_return_expr;
+
+      if (F.state == 0 && expr) {
+        F.state = 1;
+
+        this->push_frame(expr);
+
+        // (not in try block, which must catch the error of callee)
+        this->frames.back().is_tail = !this->is_in_try();
+
+        return;
+      }
+
+      auto& cs = this->get_cur_call_stack();
+
+      if (expr) {
+        cs.result = this->values[F.base];
+      }
+
+      cs.is_returned = true;
+
+      this->unwind_to_call();
+      return;
+    }
+
+    case ND_Break:
+    case ND_Continue: {
+      if (F.state == 0 && node->kind == ND_Break &&
+          node->nd_break_expr) {
+        F.state = 1;
+        this->push_frame(node->nd_break_expr);
+        return;
+      }
+
+      auto& loopContext = this->get_cur_loop_context();
+
+      loopContext.scope.is_skipped = true;
+
+      if (node->kind == ND_Break) {
+        loopContext.is_breaked = true;
+
+        if (node->nd_break_expr) {
+          loopContext.result = this->values[F.base];
+        }
+      }
+
+      this->unwind_to_loop();
+      return;
+    }
+
+    case ND_Let: {
+      if (F.state == 0) {
+        auto& scope = this->get_cur_scope();
+
+        if (!this->find_var(scope, node->nd_let_name)) {
+          this->define_var(scope, nullptr, node->nd_let_name->str);
+        }
+
+        if (node->nd_let_init) {
+          F.state = 1;
+          this->push_frame(node->nd_let_init);
+          return;
+        }
+      }
+      else {
+        this->find_var(this->get_cur_scope(), node->nd_let_name)
+            ->value = this->values[F.base];
+
+        this->check_let_type(node, this->values[F.base]);
+      }
+
+      this->finish_frame(new ObjNone);
+      return;
+    }
+
+    //
+    // scope
+    //  F.value = result of last element
+    case ND_Scope: {
+      if (node->list.empty()) {
+        this->finish_frame(new ObjNone);
+        return;
+      }
+
+      if (F.state == 0) {
+        this->enter_scope(node);
+
+        F.state = 1;
+      }
+      else {
+        F.value = this->pop_value();
+      }
+
+      auto& scope = this->get_cur_scope();
+
+      if (F.index < node->list.size() && !scope.is_skipped) {
+        auto is_tail = F.is_tail && F.index == node->list.size() - 1;
+
+        this->push_frame(node->list[F.index++]);
+        this->frames.back().is_tail = is_tail;
+
+        return;
+      }
+
+      auto ret = F.value;
+
+      this->leave_scope();
+      this->finish_frame(ret ? ret : new ObjNone);
+
+      return;
+    }
+
+    //
+    // assign
+    //  values = [(container, index,) src]
+    case ND_Assign: {
+      auto lhs = node->nd_lhs;
+
+      if (lhs->kind == ND_Variable) {
+        if (F.state == 0) {
+          F.state = 1;
+          this->push_frame(node->nd_rhs);
+          return;
+        }
+
+        auto src = this->values[F.base];
+
+        this->eval_lvalue(lhs) = src;
+        this->finish_frame(src);
+
+        return;
+      }
+
+      if (lhs->kind == ND_Subscript) {
+        switch (F.state++) {
+          case 0:
+            this->push_frame(lhs->nd_lhs);
+            return;
+
+          case 1:
+            this->push_frame(lhs->nd_rhs);
+            return;
+
+          case 2:
+            this->push_frame(node->nd_rhs);
+            return;
+        }
+
+        auto src = this->values[F.base + 2];
+
+        this->compute_subscript(lhs, this->values[F.base],
+                                this->values[F.base + 1]) = src;
+
+        this->finish_frame(src);
+        return;
+      }
+
+      break;
+    }
+  }
+
+  this->finish_frame(this->eval(node));
+}
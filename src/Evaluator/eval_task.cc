@@ -0,0 +1,154 @@
+#include <atomic>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "Error.h"
+#include "Utils.h"
+#include "Evaluator.h"
+#include "Scheduler.h"
+#include "Channel.h"
+
+//
+// ------------------------------------------------
+//  tasks
+//
+//  let f = spawn func(args);
+//  let result = await f;
+//
+//  the callee and arguments are evaluated by spawn,
+//  then the call runs on a thread of Scheduler, with
+//  a worker which has copies of the scopes and
+//  variables at spawn. (same as parallel for)
+//
+//  await runs the call itself if no thread has
+//  started it yet.
+// ------------------------------------------------
+
+Object* Evaluator::eval_spawn(Node* node)
+{
+  auto call = node->nd_spawn_call;
+
+  auto functor = this->eval_functor(call);
+  auto base = this->values.size();
+
+  this->eval_args(call);
+
+  auto future = new ObjFuture;
+  auto state = future->state;
+
+  if (!this->scheduler) {
+    auto ctx = this->get_context(node);
+
+    ctx.values = base;
+
+    // (the error is shown by await)
+    Error::enter_try();
+
+    try {
+      auto result = this->call_function(call, functor, base);
+
+      state->result = result ? result : new ObjNone;
+    }
+    catch (ScriptError const&) {
+      this->unwind(ctx);
+
+      state->error = std::current_exception();
+    }
+
+    Error::leave_try();
+
+    state->is_done = true;
+
+    return future;
+  }
+
+  auto worker = new Evaluator(this, nullptr);
+
+  //
+  // arguments are held by the task until the call
+  // (released by the callee)
+  for (auto i = base; i < this->values.size(); i++) {
+    std::atomic_ref(this->values[i]->ref_count)++;
+
+    worker->values.emplace_back(this->values[i]);
+  }
+
+  this->values.resize(base);
+
+  // (state owns the task, so it refers to state by pointer)
+  state->task = [scheduler = this->scheduler, worker, call, functor,
+                 S = state.get()] {
+    Error::enter_try();
+
+    try {
+      auto result = worker->call_function(call, functor, 0);
+
+      S->result = result ? result : new ObjNone;
+    }
+    catch (ScriptError const&) {
+      S->error = std::current_exception();
+    }
+
+    Error::leave_try();
+
+    delete worker;
+
+    S->is_done = true;
+
+    scheduler->notify();
+  };
+
+  this->scheduler->submit([state] { state->run(); });
+
+  return future;
+}
+
+Object* Evaluator::eval_await(Node* node)
+{
+  auto obj = this->eval(node->nd_await_expr);
+
+  if (!obj->type.equals(TYPE_Future)) {
+    Error(ERR_TypeMismatch, node->nd_await_expr)
+        .suggest(node->nd_await_expr,
+                 "expected `future`, but found `" +
+                     obj->type.to_string() + "`")
+        .emit()
+        .exit();
+  }
+
+  auto& state = *((ObjFuture*)obj)->state;
+
+  //
+  // run the task here if no thread has started it.
+  // otherwise, wait for the thread.
+  // (done at spawn if no scheduler)
+  if (!state.is_done && !state.run()) {
+    this->scheduler->wait([&state] { return state.is_done.load(); });
+  }
+
+  if (state.error) {
+    Error::rethrow(state.error);
+  }
+
+  return state.result;
+}
+
+bool Evaluator::recv_iterator(Node* node, ObjChannel* ch,
+                              Object*& value)
+{
+  if (ch->channel->recv(value)) {
+    return true;
+  }
+
+  if (!ch->channel->is_closed()) {
+    Error(ERR_ChannelBlocksForever, node->nd_for_range)
+        .suggest(node->nd_for_range,
+                 "channel is empty, and no thread sends to it "
+                 "(use --threads)")
+        .emit()
+        .exit();
+  }
+
+  return false;
+}
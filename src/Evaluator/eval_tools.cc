@@ -1,3 +1,6 @@
+#include <atomic>
+#include <cassert>
+
 #include "types/Object.h"
 #include "types/Node.h"
 #include "types/Token.h"
@@ -8,10 +11,43 @@
 Evaluator::CallStack::CallStack(Node* func)
     : func(func),
       is_returned(false),
-      result(nullptr)
+      result(nullptr),
+      tail_func(nullptr),
+      tail_node(nullptr),
+      typed_func(func)
 {
 }
 
+namespace {
+
+TypeKind return_type_of(Node* func)
+{
+  auto T = func->nd_func_return_type;
+
+  return T ? T->expr_type : TYPE_None;
+}
+
+}  // namespace
+
+bool Evaluator::CallStack::can_tail_call(Node* callee) const
+{
+  auto T = return_type_of(this->typed_func);
+  auto U = return_type_of(callee);
+
+  return T == TYPE_None || U == TYPE_None || T == U;
+}
+
+void Evaluator::CallStack::jump_to(Node* callee)
+{
+  if (return_type_of(this->typed_func) == TYPE_None) {
+    this->typed_func = callee;
+  }
+
+  this->func = callee;
+  this->is_returned = false;
+  this->tail_func = nullptr;
+}
+
 Evaluator::LoopContext::LoopContext(Node* node, Scope& scope)
     : node(node),
       result(nullptr),
@@ -48,24 +84,16 @@ void Evaluator::adjust_object_type(Object*& lhs, Object*& rhs)
 
 Object*& Evaluator::get_var(Token* name)
 {
-  for (auto&& scope : this->scope_stack) {
-    for (auto&& var : scope.variables) {
-      if (var.name == name->str) {
-        return var.value;
-      }
-    }
+  if (auto p = this->lookup_var(name->str); p) {
+    return *p;
   }
 
-  // find func and create func obj
-  for (auto&& scope : this->scope_stack) {
-    for (auto&& x : scope.node->list) {
+  // find func (object is created by Resolver)
+  for (auto i = this->scope_stack.size(); i-- > 0;) {
+    for (auto&& x : this->scope_stack[i].node->list) {
       if (x->kind == ND_Function &&
           x->nd_func_name->str == name->str) {
-        if (this->func_obj_map.contains(x)) {
-          return (Object*&)this->func_obj_map[x];
-        }
-
-        return (Object*&)this->func_obj_map[x] = new ObjFunction(x);
+        return x->nd_func_object;
       }
     }
   }
@@ -73,25 +101,204 @@ Object*& Evaluator::get_var(Token* name)
   Error(ERR_UndefinedVariable, name).emit().exit();
 }
 
+Object** Evaluator::lookup_var(std::string_view name)
+{
+  // variables of inner scope are on the top
+  for (auto i = this->var_stack.size(); i-- > 0;) {
+    auto& var = this->var_stack[i];
+
+    if (var.name == name) {
+      return &var.value;
+    }
+  }
+
+  return nullptr;
+}
+
 Evaluator::Scope& Evaluator::enter_scope(Node* node)
 {
-  return this->scope_stack.emplace_front(node);
+  return this->scope_stack.push(node, this->var_stack.size());
 }
 
 void Evaluator::leave_scope()
 {
-  auto& scope = this->get_cur_scope();
+  this->release_variables(this->get_cur_scope());
+
+  this->scope_stack.pop();
+}
 
-  for (auto&& v : scope.variables) {
-    v.value->ref_count--;
+Evaluator::Variable& Evaluator::define_var(Scope& scope,
+                                           Object* value,
+                                           std::string_view name)
+{
+  // only the scope on the top can have a new variable
+  assert(&scope == &this->get_cur_scope());
+
+  scope.var_count++;
+
+  return this->var_stack.push(value, name);
+}
+
+Evaluator::Variable* Evaluator::find_var(Scope& scope, Token* name)
+{
+  for (size_t i = 0; i < scope.var_count; i++) {
+    auto& var = this->var_stack[scope.var_begin + i];
+
+    if (var.name == name->str) return &var;
   }
 
-  this->scope_stack.pop_front();
+  return nullptr;
+}
+
+void Evaluator::release_variables(Scope& scope)
+{
+  for (size_t i = 0; i < scope.var_count; i++) {
+    // (objects are shared by workers of parallel for)
+    if (auto value = this->var_stack[scope.var_begin + i].value)
+      std::atomic_ref(value->ref_count)--;
+  }
+
+  this->var_stack.pop_to(scope.var_begin);
+
+  scope.var_count = 0;
+}
+
+void Evaluator::enter_loop_body(Node* node, LoopContext& loopContext,
+                                Object* range)
+{
+  // (values are computed by eval_invariant)
+  if (auto pre = node->nd_for_preheader; pre) {
+    for (auto&& x : pre->list) {
+      this->eval(x);
+    }
+  }
+
+  auto is_range = range->type.kind == TYPE_Range;
+  auto R = (ObjRange*)range;
+
+  for (auto&& x : node->list) {
+    //
+    // guard of subscript: v[iterator]
+    if (x->kind == ND_Subscript) {
+      auto vec = this->lookup_var(x->nd_lhs->token->str);
+      auto& guard = loopContext.guards[x->nd_subscript_guard];
+
+      guard = is_range && vec && *vec &&
+              (*vec)->type.kind == TYPE_Vector;
+
+      //
+      // the iterator moves between begin and end
+      if (guard) {
+        auto size = ((ObjVector*)*vec)->elements.size();
+
+        guard = R->step > 0
+                    ? R->begin >= 0 && (size_t)R->end <= size
+                    : R->end >= -1 && (size_t)R->begin < size;
+      }
+
+      continue;
+    }
+
+    auto& ind = loopContext.inductions[x->nd_induction_index];
+
+    //
+    // step is a value or an invariant variable.
+    // (not evaluated, since the error of variable must be
+    //  raised by the expression in body)
+    Object* step = x->nd_induction_step->nd_value;
+
+    if (x->nd_induction_step->kind == ND_Variable) {
+      auto p = this->lookup_var(
+          x->nd_induction_step->nd_variable_name->str);
+
+      step = p ? *p : nullptr;
+    }
+
+    ind.is_valid =
+        is_range && step && step->type.kind == TYPE_Int;
+
+    if (ind.is_valid) {
+      auto coef = ((ObjLong*)step)->value;
+
+      ind.is_valid =
+          !__builtin_mul_overflow(R->begin, coef, &ind.value) &&
+          !__builtin_mul_overflow(R->step, coef, &ind.step);
+    }
+  }
+}
+
+void Evaluator::step_inductions(LoopContext& loopContext,
+                                int64_t count)
+{
+  for (auto&& x : loopContext.node->list) {
+    if (x->kind != ND_Induction) {
+      continue;
+    }
+
+    auto& ind = loopContext.inductions[x->nd_induction_index];
+
+    if (int64_t delta; ind.is_valid) {
+      ind.is_valid =
+          !__builtin_mul_overflow(ind.step, count, &delta) &&
+          !__builtin_add_overflow(ind.value, delta, &ind.value);
+    }
+  }
+}
+
+Object* Evaluator::eval_induction(Node* node)
+{
+  for (auto i = this->loop_stack.size(); i-- > 0;) {
+    auto& loopContext = this->loop_stack[i];
+
+    if (loopContext.node != node->nd_induction_loop) {
+      continue;
+    }
+
+    if (auto& ind = loopContext.inductions[node->nd_induction_index];
+        ind.is_valid) {
+      return new ObjLong(ind.value);
+    }
+
+    break;
+  }
+
+  return this->eval(node->nd_induction_expr);
+}
+
+Object* Evaluator::eval_invariant(Node* node)
+{
+  auto p = this->lookup_var(node->nd_invariant_name->str);
+
+  if (!*p) {
+    auto value = this->eval(node->nd_invariant_expr);
+
+    // the variable holds a reference
+    // (released by leave_scope)
+    std::atomic_ref(value->ref_count)++;
+
+    // (looked up again, the stack may have grown)
+    p = this->lookup_var(node->nd_invariant_name->str);
+    *p = value;
+  }
+
+  return *p;
+}
+
+bool Evaluator::is_guarded(Node* node)
+{
+  for (auto i = this->loop_stack.size(); i-- > 0;) {
+    if (auto& loopContext = this->loop_stack[i];
+        loopContext.node == node->nd_subscript_loop) {
+      return loopContext.guards[node->nd_subscript_guard];
+    }
+  }
+
+  return false;
 }
 
 Evaluator::LoopContext& Evaluator::get_cur_loop_context()
 {
-  return *this->loop_stack.begin();
+  return this->loop_stack.top();
 }
 
 void Evaluator::loop_continue()
@@ -110,24 +317,107 @@ void Evaluator::loop_break()
 
 Evaluator::Scope& Evaluator::get_cur_scope()
 {
-  return *this->scope_stack.begin();
+  return this->scope_stack.top();
 }
 
 Evaluator::CallStack& Evaluator::get_cur_call_stack()
 {
-  return *this->call_stack.begin();
+  return this->call_stack.top();
+}
+
+//
+// append arguments to scope of callee
+void Evaluator::bind_args(Node* node, Scope& scope, Node* callee,
+                          Object* const* args, size_t count)
+{
+  auto formal = callee->list.begin();
+  size_t i = 0;
+
+  for (; formal != callee->list.end(); formal++, i++) {
+    if ((*formal)->kind == ND_VariableArguments) {
+      auto vec = new ObjVector;
+
+      for (; i < count; i++) {
+        vec->elements.emplace_back(args[i]);
+      }
+
+      vec->update_size();
+
+      this->define_var(scope, vec, (*formal)->nd_arg_name->str);
+      return;
+    }
+
+    if (i >= count) {
+      Error(ERR_TooFewArguments, node).emit().exit();
+    }
+
+    //
+    // type annotation of argument
+    // (TypeChecker assumes that it is checked here)
+    if (auto T = (*formal)->nd_arg_type;
+        T && T->expr_type != TYPE_None &&
+        args[i]->type.kind != T->expr_type) {
+      Error(ERR_TypeMismatch, *formal)
+          .suggest(*formal, "expected `" +
+                                Type(T->expr_type).to_string() +
+                                "`, but found `" +
+                                args[i]->type.to_string() + "`")
+          .emit()
+          .exit();
+    }
+
+    this->define_var(scope, args[i], (*formal)->nd_arg_name->str);
+  }
+
+  if (i < count) {
+    Error(ERR_TooManyArguments, node).emit().exit();
+  }
+}
+
+void Evaluator::check_let_type(Node* node, Object* value)
+{
+  auto T = node->nd_let_type;
+
+  if (!T || T->expr_type == TYPE_None || this->is_proven(node) ||
+      value->type.kind == T->expr_type) {
+    return;
+  }
+
+  Error(ERR_TypeMismatch, node->nd_let_init)
+      .suggest(node->nd_let_init,
+               "expected `" + Type(T->expr_type).to_string() +
+                   "`, but found `" + value->type.to_string() + "`")
+      .emit()
+      .exit();
+}
+
+void Evaluator::check_return_type(Node* callee, Object* result)
+{
+  auto T = callee->nd_func_return_type;
+
+  if (!T || T->expr_type == TYPE_None) {
+    return;
+  }
+
+  if (!result || result->type.kind != T->expr_type) {
+    Error(ERR_TypeMismatch, T)
+        .suggest(T, "expected `" + Type(T->expr_type).to_string() +
+                        "`, but found `" +
+                        (result ? result->type.to_string() : "none") +
+                        "`")
+        .emit()
+        .exit();
+  }
 }
 
 void Evaluator::check_user_func_args(Node* node, Node* nd_func,
                                      Scope& scope)
 {
   auto iter_formal = nd_func->list.begin();
-
-  auto iter_actual = scope.variables.begin();
   auto iter_actual_nd = node->list.begin();
 
-  for (; iter_actual != scope.variables.end();
-       iter_actual++, iter_formal++, iter_actual_nd++) {
+  for (size_t i = 0; i < scope.var_count;
+       i++, iter_formal++, iter_actual_nd++) {
     if ((*iter_formal)->kind == ND_VariableArguments) {
       return;
     }
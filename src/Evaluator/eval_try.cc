@@ -0,0 +1,184 @@
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "Error.h"
+#include "Utils.h"
+#include "Evaluator.h"
+
+//
+// ------------------------------------------------
+//  errors
+//
+//  let x = try { ... } catch e { ... };
+//
+//  errors are thrown as ScriptError by Error::exit(),
+//  and caught by the innermost try block. the stacks
+//  are unwound to the depths saved in try_stack, then
+//  the catch block runs with e = message of the error.
+//
+//  errors of budgets are not caught, and go to the host
+//  of isolate. (see ScriptError::is_over_budget)
+//
+//  errors in try block are not shown. (see Error::emit)
+//  errors of tasks and threads of parallel for are thrown
+//  again by await and parallel for, and shown there if
+//  not caught. (see Error::rethrow)
+// ------------------------------------------------
+
+Object* Evaluator::eval_try(Node* node)
+{
+  auto index = this->try_stack.size();
+
+  this->push_try(node);
+
+  Object* result;
+
+  try {
+    result = this->eval(node->nd_try_code);
+  }
+  catch (ScriptError const& err) {
+    if (err.is_over_budget()) {
+      this->pop_try(index);
+
+      // (shown if not in try block any more)
+      Error::rethrow(std::current_exception());
+    }
+
+    this->catch_error(index);
+
+    auto& scope = this->enter_scope(node);
+
+    if (node->nd_catch_name) {
+      this->define_var(scope, this->make_error_value(err),
+                       node->nd_catch_name->str);
+    }
+
+    result = this->eval(node->nd_catch_code);
+
+    this->leave_scope();
+
+    return result;
+  }
+
+  this->pop_try(index);
+
+  return result;
+}
+
+void Evaluator::catch_error(size_t index)
+{
+  auto ctx = this->try_stack[index];
+
+  this->pop_try(index);
+  this->unwind(ctx);
+}
+
+Evaluator::TryContext Evaluator::get_context(Node* node)
+{
+  return TryContext{
+      .node = node,
+      .frames = this->frames.size(),
+      .scopes = this->scope_stack.size(),
+      .calls = this->call_stack.size(),
+      .loops = this->loop_stack.size(),
+      .values = this->values.size(),
+  };
+}
+
+void Evaluator::unwind(TryContext const& ctx)
+{
+  while (this->scope_stack.size() > ctx.scopes) {
+    this->leave_scope();
+  }
+
+  this->call_stack.pop_to(ctx.calls);
+  this->loop_stack.pop_to(ctx.loops);
+
+  this->values.resize(ctx.values);
+}
+
+Object* Evaluator::make_error_value(ScriptError const& err)
+{
+  return new ObjString(Utils::Converter::to_wide(err.what()));
+}
+
+bool Evaluator::catch_error_frame(size_t frame_base,
+                                  ScriptError const& err)
+{
+  // (try blocks of eval() have caught the error already)
+  if (this->try_stack.empty() ||
+      this->try_stack.back().frames <= frame_base) {
+    return false;
+  }
+
+  auto index = this->try_stack.size() - 1;
+
+  //
+  // leave all try blocks of this run (see eval_try)
+  if (err.is_over_budget()) {
+    while (index > 0 &&
+           this->try_stack[index - 1].frames > frame_base) {
+      index--;
+    }
+
+    this->pop_try(index);
+
+    Error::rethrow(std::current_exception());
+  }
+
+  this->frames.erase(this->frames.begin() +
+                         this->try_stack[index].frames,
+                     this->frames.end());
+
+  this->catch_error(index);
+
+  //
+  // the frame of try enters catch block (see step)
+  auto& F = this->frames.back();
+
+  F.state = 2;
+  F.value = this->make_error_value(err);
+
+  return true;
+}
+
+void Evaluator::push_try(Node* node)
+{
+  this->try_stack.emplace_back(this->get_context(node));
+
+  Error::enter_try();
+}
+
+void Evaluator::pop_try(size_t index)
+{
+  while (this->try_stack.size() > index) {
+    this->try_stack.pop_back();
+
+    Error::leave_try();
+  }
+}
+
+bool Evaluator::is_in_try()
+{
+  return !this->try_stack.empty() &&
+         this->try_stack.back().calls == this->call_stack.size();
+}
+
+void Evaluator::reset()
+{
+  this->pop_try(0);
+
+  this->frames.clear();
+  this->values.clear();
+  this->tail_args.clear();
+
+  while (!this->scope_stack.empty()) {
+    this->leave_scope();
+  }
+
+  this->call_stack.pop_to(0);
+  this->loop_stack.pop_to(0);
+  this->var_stack.pop_to(0);
+
+  this->globals = nullptr;
+}
@@ -1,4 +1,10 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <pthread.h>
 
 #include "types/Object.h"
 #include "types/Node.h"
@@ -8,16 +14,152 @@
 #include "Utils.h"
 #include "Evaluator.h"
 #include "GC.h"
+#include "ThreadPool.h"
+#include "Scheduler.h"
+
+namespace {
+
+//
+// native stack kept for the error and builtin functions,
+// when calls are nested too deep. (see call_function)
+constexpr size_t stack_margin = 256 * 1024;
+
+//
+// lowest address of the native stack of the current thread
+// which calls may use. (0 if unknown)
+uintptr_t stack_limit()
+{
+  thread_local uintptr_t const limit = []() -> uintptr_t {
+    pthread_attr_t attr;
+    void* addr = nullptr;
+    size_t size = 0;
+
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+      return 0;
+    }
+
+    pthread_attr_getstack(&attr, &addr, &size);
+    pthread_attr_destroy(&attr);
+
+    if (!addr) {
+      return 0;
+    }
+
+    return (uintptr_t)addr + std::min(stack_margin, size / 4);
+  }();
+
+  return limit;
+}
+
+}  // namespace
 
 Evaluator::Evaluator(MetroGC& gc)
-    : _gc(gc)
+    : globals(nullptr),
+      max_frames(1 << 20),
+      steps(0),
+      next_check(std::numeric_limits<uint64_t>::max()),
+      max_steps(0),
+      own_total_steps(0),
+      total_steps(&own_total_steps),
+      deadline(std::chrono::steady_clock::time_point::max()),
+      is_unchecked(false),
+      scheduler(nullptr),
+      parent(nullptr),
+      shared_vars(0),
+      _gc(gc)
 {
   _gc.execute();
 }
 
 Evaluator::~Evaluator()
 {
-  _gc.stop();
+  // (tasks which are not awaited are finished here.
+  //  objects are deleted by the owner of heap)
+  this->own_scheduler.reset();
+
+  this->pop_try(0);
+
+  // (the rest since the last check)
+  if (this->parent) {
+    *this->total_steps += this->steps;
+  }
+}
+
+void Evaluator::set_unchecked(bool flag)
+{
+  this->is_unchecked = flag;
+}
+
+void Evaluator::set_threads(size_t count)
+{
+  this->pool.reset(count > 1 ? new ThreadPool(count) : nullptr);
+
+  // (the thread awaiting a task also runs tasks)
+  this->own_scheduler.reset(count > 1 ? new Scheduler(count - 1)
+                                      : nullptr);
+
+  this->scheduler = this->own_scheduler.get();
+}
+
+void Evaluator::set_budget(uint64_t max_steps,
+                           std::chrono::milliseconds timeout)
+{
+  this->steps = 0;
+  this->max_steps = max_steps;
+  this->own_total_steps = 0;
+
+  this->deadline = timeout.count()
+                       ? std::chrono::steady_clock::now() + timeout
+                       : std::chrono::steady_clock::time_point::max();
+
+  // (checked at the first step)
+  this->next_check =
+      max_steps || timeout.count() || this->_gc.has_limit()
+          ? 0
+          : std::numeric_limits<uint64_t>::max();
+}
+
+void Evaluator::check_budget(Node* node)
+{
+  // steps between checks
+  // (reading the clock, and adding to the total)
+  static constexpr uint64_t check_interval = 1024;
+
+  auto total = *this->total_steps += std::exchange(this->steps, 0);
+
+  this->check_heap(node);
+
+  if (this->max_steps && total > this->max_steps) {
+    Error(ERR_StepLimitExceeded, node).emit().exit();
+  }
+
+  auto has_deadline =
+      this->deadline != std::chrono::steady_clock::time_point::max();
+
+  if (has_deadline &&
+      std::chrono::steady_clock::now() >= this->deadline) {
+    Error(ERR_TimeLimitExceeded, node).emit().exit();
+  }
+
+  //
+  // steps of other threads are seen at the next check,
+  // so the limit is also checked by the interval
+  this->next_check =
+      has_deadline || this->_gc.has_limit() || this->max_steps
+          ? check_interval
+          : std::numeric_limits<uint64_t>::max();
+
+  if (this->max_steps) {
+    this->next_check =
+        std::min(this->next_check, this->max_steps - total + 1);
+  }
+}
+
+void Evaluator::check_heap(Node* node)
+{
+  if (this->_gc.is_over_limit()) {
+    Error(ERR_HeapLimitExceeded, node).emit().exit();
+  }
 }
 
 Object*& Evaluator::eval_lvalue(Node* node)
@@ -55,14 +197,241 @@ Object* Evaluator::eval_scope(Scope& scope, Node* node)
     if (scope.is_skipped)
       break;
 
-    if (!this->call_stack.empty() &&
-        this->get_cur_call_stack().is_returned)
+    if (this->is_returned())
       break;
   }
 
   return ret ? ret : new ObjNone;
 }
 
+ObjFunction* Evaluator::eval_functor(Node* node)
+{
+  auto functor = (ObjFunction*)this->eval(node->nd_callfunc_functor);
+
+  // 関数オブジェクトでないならエラー
+  if (!functor->type.equals(TYPE_Function)) {
+    Error(ERR_TypeMismatch, node->token).emit().exit();
+  }
+
+  return functor;
+}
+
+void Evaluator::eval_args(Node* node)
+{
+  for (auto&& x : node->list) {
+    // don't hold the reference of values while eval()
+    auto value = this->eval(x);
+
+    this->values.emplace_back(value);
+  }
+}
+
+Object* Evaluator::call_function(Node* node, ObjFunction* functor,
+                                 size_t base)
+{
+  // 組み込み
+  if (functor->is_builtin) {
+    auto result = functor->builtin->call(
+        node,
+        {this->values.data() + base, this->values.size() - base});
+
+    this->values.resize(base);
+
+    this->check_heap(node);
+
+    return result;
+  }
+
+  //
+  // eval() recurses on the native stack for each call,
+  // so the depth is limited by the stack of the thread.
+  // (max_frames in stackless mode)
+  if ((uintptr_t)__builtin_frame_address(0) < stack_limit()) {
+    this->values.resize(base);
+
+    Error(ERR_StackOverflow, node).emit().exit();
+  }
+
+  // callee
+  auto callee = functor->func;
+
+  //
+  // create a new scope for arguments
+  auto& scope = this->enter_scope(callee);
+
+  // append call stack
+  auto& cs = this->call_stack.push(callee);
+
+  // create arguments
+  this->bind_args(node, scope, callee, this->values.data() + base,
+                  this->values.size() - base);
+
+  this->values.resize(base);
+
+  while (true) {
+    this->count_step(node);
+
+    this->eval(callee->nd_func_code);
+
+    assert(cs.is_returned);
+
+    if (!cs.tail_func) {
+      break;
+    }
+
+    //
+    // tail call:
+    // reuse this scope and call stack for the next callee
+    // instead of nesting a new frame
+    this->release_variables(scope);
+
+    callee = cs.tail_func->func;
+
+    scope.node = callee;
+    cs.jump_to(callee);
+
+    this->bind_args(cs.tail_node, scope, callee,
+                    this->tail_args.data(), this->tail_args.size());
+  }
+
+  auto result = cs.result;
+
+  this->check_return_type(cs.typed_func, result);
+
+  this->leave_scope();
+
+  // remove call stack
+  this->call_stack.pop();
+
+  return result;
+}
+
+Object* Evaluator::invoke(Node* root, ObjFunction* functor,
+                          std::vector<Object*> const& args,
+                          bool stackless)
+{
+  auto callee = functor->func;
+
+  // node of the call (for locations of errors)
+  Node name{ND_Variable, callee->nd_func_name};
+  Node call{ND_Callfunc, callee->nd_func_name, &name, nullptr};
+
+  //
+  // (count of arguments is checked by TypeChecker in script,
+  //  but not for the call from outside)
+  // checked before entering the scope, and reported at the
+  // name of callee.
+  auto formals = callee->list.size();
+  auto is_variadic =
+      formals && callee->list.back()->kind == ND_VariableArguments;
+
+  if (args.size() < formals - is_variadic) {
+    Error(ERR_TooFewArguments, &name).emit().exit();
+  }
+  else if (!is_variadic && args.size() > formals) {
+    Error(ERR_TooManyArguments, &name).emit().exit();
+  }
+
+  Object* result;
+
+  auto is_kept = this->globals == root;
+
+  if (!is_kept) {
+    this->enter_scope(root);
+  }
+
+  if (stackless) {
+    auto const frame_base = this->frames.size();
+
+    this->push_frame(&call);
+
+    // (callee and arguments are evaluated already)
+    this->frames.back().state = 2;
+
+    this->values.emplace_back(functor);
+    this->values.insert(this->values.end(), args.begin(), args.end());
+
+    while (this->frames.size() > frame_base) {
+      this->step();
+    }
+
+    result = this->pop_value();
+  }
+  else {
+    auto base = this->values.size();
+
+    this->values.insert(this->values.end(), args.begin(), args.end());
+
+    result = this->call_function(&call, functor, base);
+  }
+
+  if (!is_kept) {
+    this->leave_scope();
+  }
+
+  return result;
+}
+
+Object* Evaluator::eval_globals(Node* root, bool stackless)
+{
+  Object* result{};
+
+  this->enter_scope(root);
+
+  // (variables are defined in the scope on the top)
+  for (auto&& x : root->list) {
+    result = stackless ? this->eval_stackless(x) : this->eval(x);
+  }
+
+  this->globals = root;
+
+  return result ? result : new ObjNone;
+}
+
+Evaluator::Globals Evaluator::get_globals()
+{
+  Globals vars;
+
+  if (!this->globals) {
+    return vars;
+  }
+
+  // (the scope kept is on the bottom)
+  auto& scope = this->scope_stack[0];
+
+  for (size_t i = 0; i < scope.var_count; i++) {
+    auto& var = this->var_stack[scope.var_begin + i];
+
+    vars.emplace_back(var.name, var.value);
+  }
+
+  return vars;
+}
+
+void Evaluator::set_globals(Node* root, Globals const& vars)
+{
+  auto& scope = this->enter_scope(root);
+
+  for (auto&& [name, value] : vars) {
+    this->define_var(scope, value, name);
+  }
+
+  this->globals = root;
+}
+
+void Evaluator::wait_tasks()
+{
+  if (this->own_scheduler) {
+    this->own_scheduler->wait_all();
+  }
+}
+
+bool Evaluator::is_returned()
+{
+  return !this->call_stack.empty() &&
+         this->get_cur_call_stack().is_returned;
+}
+
 Object* Evaluator::eval(Node* node)
 {
   if (!node) {
@@ -94,11 +463,13 @@ Object* Evaluator::eval(Node* node)
         ret->elements.emplace_back(this->eval(x));
       }
 
+      ret->update_size();
+
       return ret;
     }
 
     case ND_Function: {
-      return new ObjFunction(node);
+      return node->nd_func_object;
     }
 
     case ND_SelfFunc: {
@@ -106,14 +477,17 @@ Object* Evaluator::eval(Node* node)
         Error(ERR_HereIsNotInsideOfFunc, node).emit().exit();
       }
 
-      return new ObjFunction(this->call_stack.begin()->func);
+      return this->get_cur_call_stack().func->nd_func_object;
     }
 
     case ND_Variable: {
-      for (auto&& bfun : BuiltinFunc::builtin_functions) {
-        if (bfun.name == node->token->str) {
-          return ObjFunction::from_builtin(bfun);
-        }
+      // resolved by Resolver
+      if (node->nd_variable_func) {
+        return node->nd_variable_func;
+      }
+
+      if (auto bfun = BuiltinFunc::find(node->token->str); bfun) {
+        return ObjFunction::from_builtin(*bfun);
       }
 
       return this->eval_lvalue(node);
@@ -128,69 +502,18 @@ Object* Evaluator::eval(Node* node)
     // 関数呼び出し
     case ND_Callfunc: {
       // 呼び出し先
-      auto functor =
-          (ObjFunction*)this->eval(node->nd_callfunc_functor);
-
-      // 関数オブジェクトでないならエラー
-      if (!functor->type.equals(TYPE_Function)) {
-        Error(ERR_TypeMismatch, node->token).emit().exit();
-      }
-
-      // 組み込み
-      if (functor->is_builtin) {
-        std::vector<Object*> args;
-
-        for (auto&& x : node->list) {
-          args.emplace_back(this->eval(x));
-        }
-
-        return functor->builtin->func(node, args);
-      }
-
-      //
-      // create a new scope for arguments
-      auto& scope = this->enter_scope(functor->func);
-
-      // callee
-      auto callee = functor->func;
+      auto functor = this->eval_functor(node);
+      auto base = this->values.size();
 
-      // append call stack
-      auto& cs = this->call_stack.emplace_front(callee);
+      this->eval_args(node);
 
-      // create arguments
-      for (auto formal = functor->func->list.begin();
-           auto&& arg : node->list) {
-        auto& var = scope.variables.emplace_back(
-            this->eval(arg), (*formal++)->nd_arg_name->str);
-      }
-
-      // check arguments
-
-      /*
-      auto result = this->eval(functor->func->nd_func_code);
-
-      if (cs.is_returned)
-        result = cs.result;
-      */
-
-      this->eval(functor->func->nd_func_code);
-
-      assert(cs.is_returned);
-
-      auto result = cs.result;
-
-      this->leave_scope();
-
-      // remove call stack
-      this->call_stack.pop_front();
-
-      return result;
+      return this->call_function(node, functor, base);
     }
 
     case ND_If: {
       auto cond = this->eval(node->nd_if_cond);
 
-      if (!cond->type.equals(TYPE_Bool)) {
+      if (!this->is_proven(node) && !cond->type.equals(TYPE_Bool)) {
         Error(ERR_TypeMismatch, node->nd_if_cond)
             .suggest(node->nd_if_cond, "condition must boolean")
             .emit()
@@ -204,19 +527,23 @@ Object* Evaluator::eval(Node* node)
     //
     // for - loop
     case ND_For: {
+      if (node->is_parallel) {
+        return this->eval_parallel_for(node);
+      }
+
       auto& scope = this->enter_scope(node);
 
-      auto& loopContext = this->loop_stack.emplace_front(node, scope);
+      auto& loopContext = this->loop_stack.push(node, scope);
 
       auto objTarget = this->eval(node->nd_for_range);
 
       Object** p_iter_obj{};
-      // Token* ndvar_name{};
       bool do_define_itr = node->nd_for_iterator->kind == ND_Variable;
 
       if (node->nd_for_iterator->kind == ND_Variable) {
-        auto& V = scope.variables.emplace_back(
-            nullptr, node->nd_for_iterator->nd_variable_name->str);
+        auto& V = this->define_var(
+            scope, nullptr,
+            node->nd_for_iterator->nd_variable_name->str);
 
         p_iter_obj = &V.value;
       }
@@ -227,24 +554,54 @@ Object* Evaluator::eval(Node* node)
       switch (objTarget->type.kind) {
         case TYPE_Range: {
           auto objRange = (ObjRange*)objTarget;
+          auto code = node->nd_for_loop_code;
 
-          *p_iter_obj = new ObjLong(objRange->begin);
+          //
+          // one counter object is reused,
+          // if the iterator doesn't escape from body.
+          auto counter = node->is_unboxed
+                             ? new ObjLong(objRange->begin)
+                             : nullptr;
 
-          auto& counter = (ObjLong**&)p_iter_obj;
+          auto value = objRange->begin;
 
-          if (!(*counter)->type.equals(TYPE_Int)) {
-            (*p_iter_obj)->ref_count--;
-            *p_iter_obj = new ObjLong(objRange->begin);
+          if (!objRange->is_end(value)) {
+            this->enter_loop_body(node, loopContext, objRange);
+
+            // (the rest is evaluated by the loop below)
+            if (node->is_vectorized &&
+                this->eval_kernel(node, loopContext, objRange,
+                                  value)) {
+              value = objRange->end;
+            }
           }
 
-          for (auto begin = objRange->begin;
-               !loopContext.is_breaked && begin < objRange->end;
-               begin++) {
-            (*counter)->value = begin;
+          while (!loopContext.is_breaked && !this->is_returned() &&
+                 !objRange->is_end(value)) {
+            this->count_step(node->nd_for_range);
 
-            this->eval_scope(scope, node->nd_for_loop_code);
+            if (counter) {
+              counter->value = value;
+              *p_iter_obj = counter;
+            }
+            else {
+              *p_iter_obj = new ObjLong(value);
+            }
 
-            p_iter_obj = &this->eval_lvalue(node->nd_for_iterator);
+            if (!code->list.empty()) {
+              this->eval_scope(scope, code);
+            }
+
+            if (__builtin_add_overflow(value, objRange->step,
+                                       &value)) {
+              break;
+            }
+
+            if (!do_define_itr) {
+              p_iter_obj = &this->eval_lvalue(node->nd_for_iterator);
+            }
+
+            this->step_inductions(loopContext);
           }
 
           break;
@@ -253,11 +610,26 @@ Object* Evaluator::eval(Node* node)
         case TYPE_Vector: {
           auto objVector = (ObjVector*)objTarget;
 
-          for (auto&& elem : objVector->elements) {
-            if (loopContext.is_breaked)
+          int64_t index = 0;
+
+          if (!objVector->elements.empty()) {
+            this->enter_loop_body(node, loopContext, objVector);
+
+            if (node->is_vectorized &&
+                this->eval_kernel(node, loopContext, objVector,
+                                  index)) {
+              break;
+            }
+          }
+
+          for (; (size_t)index < objVector->elements.size();
+               index++) {
+            if (loopContext.is_breaked || this->is_returned())
               break;
 
-            *p_iter_obj = elem;
+            this->count_step(node->nd_for_range);
+
+            *p_iter_obj = objVector->elements[index];
 
             this->eval_scope(scope, node->nd_for_loop_code);
 
@@ -267,6 +639,35 @@ Object* Evaluator::eval(Node* node)
           break;
         }
 
+        //
+        // receive until the channel is closed
+        case TYPE_Channel: {
+          auto objChannel = (ObjChannel*)objTarget;
+
+          Object* value;
+
+          if (!this->recv_iterator(node, objChannel, value)) {
+            break;
+          }
+
+          this->enter_loop_body(node, loopContext, objTarget);
+
+          do {
+            this->count_step(node->nd_for_range);
+
+            *p_iter_obj = value;
+
+            this->eval_scope(scope, node->nd_for_loop_code);
+
+            if (!do_define_itr) {
+              p_iter_obj = &this->eval_lvalue(node->nd_for_iterator);
+            }
+          } while (!loopContext.is_breaked && !this->is_returned() &&
+                   this->recv_iterator(node, objChannel, value));
+
+          break;
+        }
+
         default:
           Error(ERR_TypeMismatch, node->nd_for_range)
               .suggest(node->nd_for_range,
@@ -278,7 +679,7 @@ Object* Evaluator::eval(Node* node)
 
       auto result = loopContext.result;
 
-      this->loop_stack.pop_front();
+      this->loop_stack.pop();
 
       this->leave_scope();
 
@@ -289,14 +690,63 @@ Object* Evaluator::eval(Node* node)
       return result;
     }
 
+    case ND_Induction:
+      return this->eval_induction(node);
+
+    case ND_Invariant:
+      return this->eval_invariant(node);
+
+    case ND_Spawn:
+      return this->eval_spawn(node);
+
+    case ND_Await:
+      return this->eval_await(node);
+
+    case ND_Try:
+      return this->eval_try(node);
+
     case ND_Return: {
       if (this->call_stack.empty())
         Error(ERR_CannotUseReturnHere, node).emit().exit();
 
       auto& cs = this->get_cur_call_stack();
+      auto expr = node->nd_return_expr;
+
+      //
+      // tail call:
+      // evaluate the callee and arguments here, and let the frame
+      // of current function jump into it in call_function()
+      // (not in try block, which must catch the error of callee)
+      if (expr && expr->kind == ND_Callfunc && !this->is_in_try()) {
+        auto functor = this->eval_functor(expr);
+        auto base = this->values.size();
+
+        this->eval_args(expr);
+
+        if (!functor->is_builtin &&
+            cs.can_tail_call(functor->func)) {
+          this->tail_args.assign(this->values.begin() + base,
+                                 this->values.end());
+
+          this->values.resize(base);
+
+          cs.tail_func = functor;
+          cs.tail_node = expr;
+          cs.is_returned = true;
+
+          return nullptr;
+        }
 
-      if (node->nd_return_expr) {
-        cs.result = this->eval(node->nd_return_expr);
+        cs.result = this->call_function(expr, functor, base);
+      }
+      else if (expr) {
+        auto result = this->eval(expr);
+
+        // (return in the expression, as `return if ...` made by
+        //  Parser::to_return_stmt, has set the result already)
+        if (!cs.is_returned) {
+          cs.result = result;
+        }
       }
 
       cs.is_returned = true;
@@ -308,6 +758,11 @@ Object* Evaluator::eval(Node* node)
     case ND_Continue: {
       auto& loopContext = this->get_cur_loop_context();
 
+      // (iterations of parallel for are not ordered)
+      if (node->kind == ND_Break && loopContext.node->is_parallel) {
+        Error(ERR_CannotUseBreakHere, node->token).emit().exit();
+      }
+
       loopContext.scope.is_skipped = true;
 
       if (node->kind == ND_Break) {
@@ -326,15 +781,17 @@ Object* Evaluator::eval(Node* node)
 
       Variable* pvar{};
 
-      if (!(pvar = scope.find_var(node->nd_let_name))) {
-        pvar = &scope.variables.emplace_back(nullptr,
-                                             node->nd_let_name->str);
+      if (!(pvar = this->find_var(scope, node->nd_let_name))) {
+        pvar = &this->define_var(scope, nullptr,
+                                 node->nd_let_name->str);
       }
 
       assert(pvar);
 
       if (node->nd_let_init) {
         pvar->value = this->eval(node->nd_let_init);
+
+        this->check_let_type(node, pvar->value);
       }
 
       goto __none;
@@ -356,20 +813,7 @@ Object* Evaluator::eval(Node* node)
       auto begin = this->eval(node->nd_lhs);
       auto end = this->eval(node->nd_rhs);
 
-      if (!begin->type.equals(TYPE_Int))
-        Error(ERR_TypeMismatch, node->nd_lhs)
-            .suggest(node->nd_lhs, "expected integer")
-            .emit()
-            .exit();
-
-      if (!end->type.equals(TYPE_Int))
-        Error(ERR_TypeMismatch, node->nd_rhs)
-            .suggest(node->nd_rhs, "expected integer")
-            .emit()
-            .exit();
-
-      return new ObjRange(((ObjLong*)begin)->value,
-                          ((ObjLong*)end)->value);
+      return this->compute_range(node, begin, end);
     }
 
     case ND_Bigger:
@@ -389,64 +833,7 @@ Object* Evaluator::eval(Node* node)
       for (auto&& item : items) {
         auto rhs = this->eval(item->nd_rhs);
 
-        this->adjust_object_type(lhs, rhs);
-
-        if (!lhs->type.equals(rhs->type)) {
-          Error(ERR_TypeMismatch, node).emit().exit();
-        }
-
-        auto result = false;
-
-        switch (item->kind) {
-          case ND_Bigger:
-            switch (lhs->type.kind) {
-              case TYPE_Int:
-                result =
-                    ((ObjLong*)lhs)->value > ((ObjLong*)rhs)->value;
-                break;
-
-              case TYPE_Float:
-                result =
-                    ((ObjFloat*)lhs)->value > ((ObjFloat*)rhs)->value;
-                break;
-            }
-            break;
-
-          case ND_BiggerOrEqual:
-            switch (lhs->type.kind) {
-              case TYPE_Int:
-                result =
-                    ((ObjLong*)lhs)->value >= ((ObjLong*)rhs)->value;
-                break;
-
-              case TYPE_Float:
-                result = ((ObjFloat*)lhs)->value >=
-                         ((ObjFloat*)rhs)->value;
-                break;
-            }
-            break;
-
-          case ND_Equal:
-          case ND_NotEqual:
-            switch (lhs->type.kind) {
-              case TYPE_Int:
-                result =
-                    ((ObjLong*)lhs)->value == ((ObjLong*)rhs)->value;
-                break;
-
-              case TYPE_Float:
-                result = ((ObjFloat*)lhs)->value ==
-                         ((ObjFloat*)rhs)->value;
-                break;
-            }
-
-            if (item->kind == ND_NotEqual)
-              result ^= 1;
-
-            break;
-        }
-
-        if (!result) {
+        if (!this->compute_compare(node, item, lhs, rhs)) {
           return new ObjBool(false);
         }
 
@@ -457,6 +844,10 @@ Object* Evaluator::eval(Node* node)
     }
 
     case ND_Assign: {
+      if (this->parent && node->nd_lhs->kind == ND_Variable) {
+        this->check_shared_var(node->nd_lhs);
+      }
+
       auto& dest = this->eval_lvalue(node->nd_lhs);
 
       auto src = this->eval(node->nd_rhs);
@@ -1,36 +1,48 @@
-#include <list>
-#include <functional>
+#include <limits>
+#include <unordered_set>
+
 #include "types/Object.h"
+#include "Channel.h"
 #include "GC.h"
 #include "Utils.h"
 
+namespace {
+
+//
+// bytes of an object without the buffer
+// (about the largest one, since the type is not known
+//  in the constructor of Object)
+constexpr size_t object_size = 64;
+
+size_t bytes_of(Object* object)
+{
+  return object_size + object->buffer_bytes;
+}
+
+}  // namespace
+
 #define MTX_LOCK                \
   std::lock_guard<std::mutex> M \
   {                             \
     this->_mtx                  \
   }
 
-static std::list<MetroGC*> _g_mgc_inst_list;
-
 MetroGC::MetroGC()
     : _is_running(false),
-      _is_pausing(false)
+      _is_pausing(false),
+      _bytes(0),
+      _limit(std::numeric_limits<size_t>::max())
 {
-  _g_mgc_inst_list.push_front(this);
 }
 
 MetroGC::~MetroGC()
 {
-  _g_mgc_inst_list.pop_front();
 }
 
 void MetroGC::execute()
 {
   MTX_LOCK;
   this->_is_running = true;
-
-  this->_routine.reset(
-      new std::thread(std::mem_fn(&MetroGC::_thread_routine), this));
 }
 
 void MetroGC::stop()
@@ -38,81 +50,180 @@ void MetroGC::stop()
   MTX_LOCK;
   this->_is_running = false;
 
-  this->_routine->join();
-
   for (auto&& obj : this->_objects) {
     if (obj) {
       delete obj;
     }
   }
+
+  this->_objects.clear();
+  this->_free_slots.clear();
+
+  this->_bytes = 0;
 }
 
-void MetroGC::pause()
+size_t MetroGC::mark()
 {
   MTX_LOCK;
-  this->_is_pausing = true;
+
+  // (new objects are appended after the mark)
+  this->_free_slots.clear();
+
+  return this->_objects.size();
 }
 
-void MetroGC::resume()
+void MetroGC::release(size_t mark)
 {
   MTX_LOCK;
-  this->_is_pausing = false;
+
+  for (auto i = mark; i < this->_objects.size(); i++) {
+    if (this->_objects[i]) {
+      this->_bytes -= bytes_of(this->_objects[i]);
+      delete this->_objects[i];
+    }
+  }
+
+  this->_objects.resize(mark);
+
+  std::erase_if(this->_free_slots,
+                [mark](size_t index) { return index >= mark; });
 }
 
-Object*& MetroGC::append(Object* object)
+void MetroGC::sweep(size_t mark, std::vector<Object*> const& roots)
 {
+  std::unordered_set<Object*> reachable;
+  std::vector<Object*> stack{roots};
+
+  while (!stack.empty()) {
+    auto obj = stack.back();
+
+    stack.pop_back();
+
+    if (!obj || !reachable.emplace(obj).second) {
+      continue;
+    }
+
+    switch (obj->type.kind) {
+      case TYPE_Tuple:
+      case TYPE_Vector: {
+        auto& elements = ((ObjVector*)obj)->elements;
+
+        stack.insert(stack.end(), elements.begin(), elements.end());
+        break;
+      }
+
+      case TYPE_Future:
+        stack.emplace_back(((ObjFuture*)obj)->state->result);
+        break;
+
+      case TYPE_Channel:
+        ((ObjChannel*)obj)->channel->for_each(
+            [&stack](Object* x) { stack.emplace_back(x); });
+        break;
+    }
+  }
+
   MTX_LOCK;
 
-  for (auto&& p : this->_objects) {
-    if (!p) {
-      return p = object;
+  // (left objects are moved to front, to keep the order)
+  auto end = mark;
+
+  for (auto i = mark; i < this->_objects.size(); i++) {
+    auto obj = this->_objects[i];
+
+    if (!obj) {
+      continue;
     }
+
+    if (reachable.contains(obj)) {
+      this->_objects[end++] = obj;
+      continue;
+    }
+
+    this->_bytes -= bytes_of(obj);
+    delete obj;
   }
 
-  return this->_objects.emplace_back(object);
+  this->_objects.resize(end);
+
+  std::erase_if(this->_free_slots,
+                [mark](size_t index) { return index >= mark; });
 }
 
-void MetroGC::remove(Object* object)
+size_t MetroGC::size()
 {
   MTX_LOCK;
 
-  for (auto&& p : this->_objects) {
-    if (p == object) {
-      p = nullptr;
-      break;
-    }
-  }
+  return this->_objects.size();
 }
 
-void MetroGC::clean()
+void MetroGC::for_each(std::function<void(Object*)> const& fn)
 {
   MTX_LOCK;
 
-  for (auto&& pObj : this->_objects) {
-    if (pObj && pObj->ref_count == 0) {
-      delete pObj;
-      pObj = nullptr;
-      break;
+  for (auto&& obj : this->_objects) {
+    if (obj) {
+      fn(obj);
     }
   }
 }
 
-MetroGC* MetroGC::get_instance()
+void MetroGC::set_limit(size_t max_bytes)
+{
+  MTX_LOCK;
+
+  this->_limit =
+      max_bytes ? max_bytes : std::numeric_limits<size_t>::max();
+}
+
+void MetroGC::pause()
+{
+  MTX_LOCK;
+  this->_is_pausing = true;
+}
+
+void MetroGC::resume()
+{
+  MTX_LOCK;
+  this->_is_pausing = false;
+}
+
+Object*& MetroGC::append(Object* object)
 {
-  return *_g_mgc_inst_list.begin();
+  MTX_LOCK;
+
+  this->_bytes += bytes_of(object);
+
+  if (!this->_free_slots.empty()) {
+    auto index = this->_free_slots.back();
+
+    this->_free_slots.pop_back();
+
+    return this->_objects[index] = object;
+  }
+
+  return this->_objects.emplace_back(object);
 }
 
-void MetroGC::_thread_routine()
+void MetroGC::remove(Object* object)
 {
-  while (this->_is_running) {
-    this->clean();
-    this->_sleep(1000);
+  MTX_LOCK;
+
+  for (size_t i = 0; i < this->_objects.size(); i++) {
+    if (this->_objects[i] == object) {
+      this->_bytes -= bytes_of(object);
+      this->_objects[i] = nullptr;
+      this->_free_slots.emplace_back(i);
+      break;
+    }
   }
 }
 
-void MetroGC::_sleep(int milli)
+void MetroGC::resize(Object* object, size_t bytes)
 {
-  for (int i = 0; i < milli && this->_is_running; i++) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  // (no lock, the object is used by one thread at a time)
+  if (bytes != object->buffer_bytes) {
+    this->_bytes += bytes - object->buffer_bytes;
+    object->buffer_bytes = bytes;
   }
 }
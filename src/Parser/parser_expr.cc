@@ -240,6 +240,31 @@ Node* Parser::unary()
                             this->new_value_nd(new ObjLong(1)));
   }
 
+  // spawn f(args)
+  else if (this->eat("spawn")) {
+    auto node = new Node(ND_Spawn, this->ate);
+
+    node->nd_spawn_call = this->member_access();
+
+    if (node->nd_spawn_call->kind != ND_Callfunc) {
+      Error(ERR_InvalidSyntax, node->token)
+          .suggest(node->nd_spawn_call, "expected function call")
+          .emit()
+          .exit();
+    }
+
+    return node;
+  }
+
+  // await future
+  else if (this->eat("await")) {
+    auto node = new Node(ND_Await, this->ate);
+
+    node->nd_await_expr = this->unary();
+
+    return node;
+  }
+
   this->eat("+");
 
   return this->member_access();
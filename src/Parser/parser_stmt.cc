@@ -31,11 +31,25 @@ Node* Parser::statement()
 
   //
   // for
-  if (this->eat("for")) {
+  // parallel for
+  if (auto is_parallel = this->eat("parallel");
+      is_parallel || this->eat("for")) {
+    if (is_parallel) {
+      this->expect("for");
+    }
+
     auto node = new Node(ND_For, this->ate);
 
+    node->is_parallel = is_parallel;
     node->nd_for_iterator = this->expr();
 
+    // iterator is defined in each thread
+    if (is_parallel && node->nd_for_iterator->kind != ND_Variable) {
+      Error(ERR_ExpectedIdentifier, node->nd_for_iterator->token)
+          .emit()
+          .exit();
+    }
+
     this->expect("in");
 
     node->nd_for_range = this->expr();
@@ -45,6 +59,25 @@ Node* Parser::statement()
     return node;
   }
 
+  //
+  // try { ... } catch e { ... }
+  // (e is the message of error, and can be omitted)
+  if (this->eat("try")) {
+    auto node = new Node(ND_Try, this->ate);
+
+    node->nd_try_code = this->expect_scope();
+
+    this->expect("catch");
+
+    if (this->cur->kind == TOK_Ident) {
+      node->nd_catch_name = this->expect_ident();
+    }
+
+    node->nd_catch_code = this->expect_scope();
+
+    return node;
+  }
+
   //
   // return
   if (this->eat("return")) {
@@ -126,10 +126,35 @@ Node* Parser::to_return_stmt(Node* node)
               .emit()
               .exit();
         }
+
+        //
+        // 各分岐の末尾を return 文にする
+        // (末尾呼び出しを検出できるようにするため)
+        if (this->is_tail_rewritable(node->nd_if_true) &&
+            this->is_tail_rewritable(node->nd_if_false)) {
+          node->nd_if_true = this->to_return_stmt(node->nd_if_true);
+          node->nd_if_false = this->to_return_stmt(node->nd_if_false);
+
+          return node;
+        }
       }
 
       break;
     }
+
+    //
+    // スコープ : 最後の要素を return 文にする
+    case ND_Scope: {
+      if (!this->is_tail_rewritable(node)) {
+        break;
+      }
+
+      auto& last = *node->list.rbegin();
+
+      last = this->to_return_stmt(last);
+
+      return node;
+    }
   }
 
   auto nd_ret = new Node(ND_Return, node->token);
@@ -139,6 +164,22 @@ Node* Parser::to_return_stmt(Node* node)
   return nd_ret;
 }
 
+//
+// to_return_stmt で中身まで書き換えられるノードかどうか
+bool Parser::is_tail_rewritable(Node* node)
+{
+  switch (node->kind) {
+    case ND_If:
+      return node->nd_if_false != nullptr;
+
+    case ND_Scope:
+      return !node->list.empty() &&
+             (*node->list.rbegin())->kind != ND_None;
+  }
+
+  return true;
+}
+
 Object* Parser::check_value_range(Token* token)
 {
   try {
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "Utils.h"
+#include "Batch.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point begin)
+{
+  return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+}  // namespace
+
+Batch::Batch(Options const& options, size_t workers)
+    : options(options),
+      count(std::max<size_t>(workers, 1)),
+      next(0)
+{
+}
+
+bool Batch::run(char const* dir)
+{
+  std::error_code ec;
+
+  for (std::filesystem::recursive_directory_iterator it{dir, ec}, end;
+       !ec && it != end; it.increment(ec)) {
+    if (it->is_regular_file() && it->path().extension() == ".metro") {
+      auto& script = this->scripts.emplace_back();
+
+      script.path = it->path().string();
+    }
+  }
+
+  if (ec) {
+    std::cerr << "cannot read directory: " << dir << std::endl;
+    return false;
+  }
+
+  std::sort(this->scripts.begin(), this->scripts.end(),
+            [](Script const& a, Script const& b) {
+              return a.path < b.path;
+            });
+
+  auto begin = Clock::now();
+
+  {
+    std::vector<std::thread> workers;
+
+    // (no more threads than scripts)
+    for (size_t i = 0;
+         i < std::min(this->count, this->scripts.size()); i++) {
+      workers.emplace_back(&Batch::worker_routine, this);
+    }
+
+    for (auto&& th : workers) {
+      th.join();
+    }
+  }
+
+  auto total = seconds_since(begin);
+
+  size_t failed = 0;
+
+  for (auto&& script : this->scripts) {
+    std::cout << "--- " << script.path << "\n" << script.output;
+
+    if (!script.output.empty() && !script.output.ends_with('\n')) {
+      std::cout << "\n";
+    }
+  }
+
+  for (auto&& script : this->scripts) {
+    std::cout << Utils::format("%-6s %.6fs  ",
+                               script.is_ok ? "ok" : "error",
+                               script.seconds)
+              << script.path << "\n";
+
+    if (!script.is_ok) {
+      failed++;
+    }
+  }
+
+  std::cout << Utils::format(
+                   "%zu scripts, %zu ok, %zu failed (%.3fs)",
+                   this->scripts.size(),
+                   this->scripts.size() - failed, failed, total)
+            << std::endl;
+
+  return failed == 0;
+}
+
+void Batch::worker_routine()
+{
+  for (size_t i; (i = this->next++) < this->scripts.size();) {
+    this->run_script(this->scripts[i]);
+  }
+}
+
+void Batch::run_script(Script& script)
+{
+  auto begin = Clock::now();
+
+  std::ostringstream out;
+
+  Isolate isolate{this->options};
+
+  isolate.set_output(out);
+
+  if (!isolate.load_file(script.path.c_str())) {
+    out << "cannot open file: " << script.path << "\n";
+  }
+  else {
+    try {
+      isolate.execute();
+      script.is_ok = true;
+    }
+    catch (ScriptError const&) {
+      // (the error is written to the output already)
+    }
+  }
+
+  script.output = out.str();
+  script.seconds = seconds_since(begin);
+}
@@ -1,4 +1,7 @@
-#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include "types/Object.h"
 #include "types/Node.h"
@@ -6,114 +9,204 @@
 #include "types/BuiltinFunc.h"
 #include "Error.h"
 #include "Utils.h"
+#include "Isolate.h"
+#include "Channel.h"
 
-#define blambda(e) [](Node * node, BF_Args const& args) -> Object* e
-
-using BF_Args = std::vector<Object*>;
+namespace {
 
-class BuiltinBuilder {
- public:
-  static BuiltinFunc create(char const* name,
-                            std::vector<Type> const& arg_types,
-                            BuiltinFunc::FuncType fp)
+//
+// ------------------------------------------------
+//  ArgTraits
+//
+//  C++ の引数型と metro の型の対応
+//  kind == TYPE_None ならどの型でも受け取る
+// ------------------------------------------------
+template <class T>
+struct ArgTraits;
+
+template <class T, TypeKind K>
+struct ObjArgTraits {
+  static constexpr TypeKind kind = K;
+
+  static T* get(Object* obj)
   {
-    // dont free instance !
-    auto builder = new BuiltinBuilder(arg_types, fp);
-
-    return BuiltinFunc{name, builder->wrapper};
+    return static_cast<T*>(obj);
   }
+};
 
- private:
-  BuiltinBuilder(std::vector<Type> const& args,
-                 BuiltinFunc::FuncType fp)
-      : arg_types(args),
-        _actual_func(fp)
+template <>
+struct ArgTraits<Object*> : ObjArgTraits<Object, TYPE_None> {
+};
+
+template <>
+struct ArgTraits<ObjLong*> : ObjArgTraits<ObjLong, TYPE_Int> {
+};
+
+template <>
+struct ArgTraits<ObjString*> : ObjArgTraits<ObjString, TYPE_String> {
+};
+
+template <>
+struct ArgTraits<ObjVector*> : ObjArgTraits<ObjVector, TYPE_Vector> {
+};
+
+template <>
+struct ArgTraits<ObjRange*> : ObjArgTraits<ObjRange, TYPE_Range> {
+};
+
+template <>
+struct ArgTraits<ObjChannel*>
+    : ObjArgTraits<ObjChannel, TYPE_Channel> {
+};
+
+//
+// unboxed int
+template <>
+struct ArgTraits<int64_t> {
+  static constexpr TypeKind kind = TYPE_Int;
+
+  static int64_t get(Object* obj)
   {
-    this->wrapper =
-        std::bind(&BuiltinBuilder::call_wrap, this,
-                  std::placeholders::_1, std::placeholders::_2);
+    return static_cast<ObjLong*>(obj)->value;
+  }
+};
+
+//
+// ------------------------------------------------
+//  BuiltinBinder
+//
+//  C++ の関数シグネチャから引数の型を推論して、
+//  BuiltinFunc::FuncType の形に変換する
+//
+//  R fn(Node*, T1, T2, ..., [BF_Args rest])
+//
+//  最後の引数が BF_Args なら、残りの引数をすべて受け取る
+// ------------------------------------------------
+template <auto Fn>
+struct BuiltinBinder;
+
+template <class... Params>
+constexpr bool is_last_args()
+{
+  if constexpr (sizeof...(Params) == 0) {
+    return false;
+  }
+  else {
+    return std::is_same_v<std::tuple_element_t<sizeof...(Params) - 1,
+                                               std::tuple<Params...>>,
+                          BF_Args>;
   }
+}
+
+template <class R, class... Params, R (*Fn)(Node*, Params...)>
+struct BuiltinBinder<Fn> {
+  static constexpr bool is_variadic = is_last_args<Params...>();
+
+  static constexpr size_t fixed_count =
+      sizeof...(Params) - is_variadic;
+
+  using ParamTypes = std::tuple<Params...>;
 
-  Object* call_wrap(Node* node,
-                    std::vector<Object*> const& actual_args)
+  static_assert((std::is_same_v<Params, BF_Args> + ... + 0) ==
+                    is_variadic,
+                "BF_Args must be the last parameter");
+
+  static Object* call(Node* node, BF_Args args)
   {
-    if (this->arg_types.empty() && !actual_args.empty()) {
-      Error(ERR_TooManyArguments, node).emit().exit();
+    if (args.size() < fixed_count) {
+      Error(ERR_TooFewArguments, node).emit().exit();
     }
 
-    auto nd_arg = node->list.begin();
-    auto formal = this->arg_types.begin();
-
-    for (auto&& act_obj : actual_args) {
-      // if end
-      if (formal == this->arg_types.end()) {
-        Error(ERR_TooManyArguments, node)
-            .suggest(*nd_arg, "don't need this argument")
-            .emit()
-            .exit();
-      }
+    if (!is_variadic && args.size() > fixed_count) {
+      Error(ERR_TooManyArguments, node)
+          .suggest(node->list[fixed_count],
+                   "don't need this argument")
+          .emit()
+          .exit();
+    }
 
-      if (formal->equals(TYPE_Args)) {
-        break;
-      }
+    return invoke(node, args,
+                  std::make_index_sequence<fixed_count>{});
+  }
 
-      // no matching type
-      if (!formal->equals(act_obj->type)) {
-        Error(ERR_IllegalFunctionCall, *nd_arg)
-            .suggest(*nd_arg, "expected `" + formal->to_string() +
-                                  "`, but found `" +
-                                  act_obj->type.to_string() + "`")
-            .emit();
-      }
+ private:
+  template <class T>
+  static bool check_arg(Node* node, Object* obj, size_t index)
+  {
+    constexpr auto kind = ArgTraits<T>::kind;
 
-      formal++;
-      nd_arg++;
+    if (kind == TYPE_None || obj->type.kind == kind) {
+      return true;
     }
 
-    if (formal != this->arg_types.end() && !formal->equals(TYPE_Args))
-      Error(ERR_TooFewArguments, node).emit();
+    auto nd_arg = node->list[index];
 
-    Error::check();
+    Error(ERR_IllegalFunctionCall, nd_arg)
+        .suggest(nd_arg, "expected `" + Type(kind).to_string() +
+                             "`, but found `" +
+                             obj->type.to_string() + "`")
+        .emit();
 
-    return this->_actual_func(node, actual_args);
+    return false;
   }
 
-  std::vector<Type> arg_types;
-
-  BuiltinFunc::FuncType wrapper;
+  template <size_t... I>
+  static Object* invoke(Node* node, BF_Args args,
+                        std::index_sequence<I...>)
+  {
+    // 型が違う引数はすべて報告してから終了する
+    if (!(check_arg<std::tuple_element_t<I, ParamTypes>>(
+              node, args[I], I) &
+          ... & true)) {
+      Error(ERR_IllegalFunctionCall, node).exit();
+    }
 
-  BuiltinFunc::FuncType _actual_func;
+    if constexpr (is_variadic) {
+      return Fn(node,
+                ArgTraits<std::tuple_element_t<I, ParamTypes>>::get(
+                    args[I])...,
+                args.subspan(fixed_count));
+    }
+    else {
+      return Fn(node,
+                ArgTraits<std::tuple_element_t<I, ParamTypes>>::get(
+                    args[I])...);
+    }
+  }
 };
 
-BuiltinFunc::BuiltinFunc(char const* name, BuiltinFunc::FuncType func)
-    : name(name),
-      func(func)
+template <auto Fn>
+constexpr BuiltinFunc bind_builtin(char const* name)
 {
+  return {name, &BuiltinBinder<Fn>::call};
 }
 
-namespace {
-
-// print
-Object* bf_print(Node* node, BF_Args const& args)
+// abs
+ObjLong* bf_abs(Node*, int64_t value)
 {
-  auto ret = new ObjLong;
-
-  for (auto&& arg : args) {
-    auto&& s = arg->to_string();
+  return new ObjLong(std::abs(value));
+}
 
-    ret->value += s.length();
+// append
+Object* bf_append(Node* node, ObjVector* vec, BF_Args items)
+{
+  if (items.empty()) {
+    Error(ERR_TooFewArguments, node).emit().exit();
+  }
 
-    std::cout << s;
+  for (auto&& item : items) {
+    vec->elements.emplace_back(item);
   }
 
-  return ret;
-};
+  vec->update_size();
+
+  return vec;
+}
 
 // format
-Object* bf_format(Node* node, BF_Args const& args)
+ObjString* bf_format(Node* node, ObjString* fmt, BF_Args args)
 {
-  auto it = args.begin() + 1;
-  auto fmt = (ObjString*)args[0];
+  auto it = args.begin();
 
   auto ret = new ObjString;
 
@@ -145,94 +238,267 @@ Object* bf_format(Node* node, BF_Args const& args)
   return ret;
 }
 
-}  // namespace
+//
+// ---- type constructors -----
+Object* bf_vector(Node* node, BF_Args args)
+{
+  auto ret = new ObjVector();
+
+  if (args.size() == 1) {
+    switch (args[0]->type.kind) {
+      case TYPE_Int:
+        for (int64_t i = 0; i < ((ObjLong*)args[0])->value; i++) {
+          ret->append(new ObjLong(i));
+        }
+
+        break;
+
+      case TYPE_Range: {
+        auto R = (ObjRange*)args[0];
+
+        for (int64_t i = R->begin; !R->is_end(i);) {
+          ret->append(new ObjLong(i));
+
+          if (__builtin_add_overflow(i, R->step, &i)) break;
+        }
+
+        break;
+      }
+    }
+  }
+
+  // (any), int
+  //  --> item, count
+  else if (args.size() == 2 && args[1]->type.equals(TYPE_Int)) {
+    for (int64_t i = 0; i < ((ObjLong*)args[1])->value; i++) {
+      ret->append(args[0]);
+    }
+  }
+  else {
+    Error(ERR_IllegalFunctionCall, node).emit().exit();
+  }
+
+  return ret;
+}
+
+// range
+//  range(begin, end, [step])
+ObjRange* bf_range(Node* node, int64_t begin, int64_t end,
+                   BF_Args args)
+{
+  int64_t step = 1;
+
+  if (args.size() > 1) {
+    Error(ERR_TooManyArguments, node)
+        .suggest(node->list[3], "don't need this argument")
+        .emit()
+        .exit();
+  }
+
+  if (!args.empty()) {
+    if (!args[0]->type.equals(TYPE_Int)) {
+      Error(ERR_IllegalFunctionCall, node->list[2])
+          .suggest(node->list[2], "expected `int`, but found `" +
+                                      args[0]->type.to_string() + "`")
+          .emit()
+          .exit();
+    }
 
-std::vector<BuiltinFunc> const BuiltinFunc::builtin_functions = {
-    // abs
-    BuiltinBuilder::create(
-        "abs", {TYPE_Int}, blambda({
-          return new ObjLong(std::abs(((ObjLong*)args[0])->value));
-        })),
-
-    // append
-    {"append", blambda({
-       if (args.size() < 2 || !args[0]->type.equals(TYPE_Vector)) {
-         Error(ERR_IllegalFunctionCall, node).emit().exit();
-       }
-
-       for (auto it = args.begin() + 1; it != args.end(); it++)
-         ((ObjVector*)args[0])->elements.emplace_back(*it);
-
-       return args[0];
-     })},
-
-    // format
-    BuiltinBuilder::create("format", {TYPE_String, TYPE_Args},
-                           bf_format),
-
-    //
-    // ---- type constructors -----
-    {"vector", blambda({
-       auto ret = new ObjVector();
-
-       if (args.size() == 1) {
-         switch (args[0]->type.kind) {
-           case TYPE_Int:
-             for (int64_t i = 0; i < ((ObjLong*)args[0])->value;
-                  i++) {
-               ret->append(new ObjLong(i));
-             }
-
-             break;
-
-           case TYPE_Range: {
-             auto R = (ObjRange*)args[0];
-
-             for (int64_t i = R->begin; i < R->end; i++) {
-               ret->append(new ObjLong(i));
-             }
-
-             break;
-           }
-         }
-       }
-
-       // (any), int
-       //  --> item, count
-       else if (args.size() == 2 && args[1]->type.equals(TYPE_Int)) {
-         for (int64_t i = 0; i < ((ObjLong*)args[1])->value; i++) {
-           ret->append(args[0]);
-         }
-       }
-       else {
-         Error(ERR_IllegalFunctionCall, node).emit().exit();
-       }
-
-       return ret;
-     })},
-
-    // print
-    BuiltinBuilder::create("print", {TYPE_Args}, bf_print),
-
-    // println
-    BuiltinBuilder::create("println", {TYPE_Args}, blambda({
-                             auto ret = bf_print(node, args);
-
-                             std::cout << std::endl;
-
-                             ((ObjLong*)ret)->value++;
-                             return ret;
-                           })),
-
-    // printf
-    BuiltinBuilder::create(
-        "printf", {TYPE_String, TYPE_Args}, blambda({
-          auto s = (ObjString*)bf_format(node, args);
-
-          std::cout << s->to_string();
-
-          auto ret = new ObjLong(s->value.length());
-
-          return ret;
-        })),
+    if ((step = ((ObjLong*)args[0])->value) == 0) {
+      Error(ERR_InvalidRange, node->list[2])
+          .suggest(node->list[2], "step must not be zero")
+          .emit()
+          .exit();
+    }
+  }
+
+  return new ObjRange(begin, end, step);
+}
+
+//
+// ---- channel -----
+
+// channel(capacity)
+ObjChannel* bf_channel(Node* node, int64_t capacity)
+{
+  if (capacity <= 0) {
+    Error(ERR_ValueOutOfRange, node->list[0])
+        .suggest(node->list[0], "capacity must be positive")
+        .emit()
+        .exit();
+  }
+
+  return new ObjChannel(std::make_shared<Channel>(capacity));
+}
+
+// send(ch, value)
+//  block while the channel is full
+Object* bf_send(Node* node, ObjChannel* ch, Object* value)
+{
+  if (ch->channel->send(value)) {
+    return new ObjNone;
+  }
+
+  if (ch->channel->is_closed()) {
+    Error(ERR_SendToClosedChannel, node).emit().exit();
+  }
+
+  Error(ERR_ChannelBlocksForever, node)
+      .suggest(node, "channel is full, and no thread receives from "
+                     "it (use --threads)")
+      .emit()
+      .exit();
+}
+
+// recv(ch)
+//  block while the channel is empty.
+//  none if the channel is closed and empty.
+Object* bf_recv(Node* node, ObjChannel* ch)
+{
+  if (Object* value; ch->channel->recv(value)) {
+    return value;
+  }
+
+  if (!ch->channel->is_closed()) {
+    Error(ERR_ChannelBlocksForever, node)
+        .suggest(node, "channel is empty, and no thread sends to it "
+                       "(use --threads)")
+        .emit()
+        .exit();
+  }
+
+  return new ObjNone;
+}
+
+// try_send(ch, value)
+//  false if the channel is full
+ObjBool* bf_try_send(Node* node, ObjChannel* ch, Object* value)
+{
+  if (ch->channel->is_closed()) {
+    Error(ERR_SendToClosedChannel, node).emit().exit();
+  }
+
+  return new ObjBool(ch->channel->try_send(value));
+}
+
+// try_recv(ch)
+//  none if the channel is empty
+Object* bf_try_recv(Node*, ObjChannel* ch)
+{
+  if (Object* value; ch->channel->try_recv(value)) {
+    return value;
+  }
+
+  return new ObjNone;
+}
+
+// close(ch)
+Object* bf_close(Node*, ObjChannel* ch)
+{
+  ch->channel->close();
+
+  return new ObjNone;
+}
+
+// (arguments of print are concatenated)
+static std::string concat_args(BF_Args args)
+{
+  std::string text;
+
+  for (auto&& arg : args) {
+    text += arg->to_string();
+  }
+
+  return text;
+}
+
+// print
+ObjLong* bf_print(Node*, BF_Args args)
+{
+  auto text = concat_args(args);
+
+  Isolate::current()->write(text);
+
+  return new ObjLong(text.length());
+}
+
+// println
+ObjLong* bf_println(Node*, BF_Args args)
+{
+  auto text = concat_args(args);
+
+  // (written at once, not mixed with other threads)
+  Isolate::current()->write(text + "\n");
+
+  return new ObjLong(text.length() + 1);
+}
+
+// printf
+ObjLong* bf_printf(Node* node, ObjString* fmt, BF_Args args)
+{
+  auto s = bf_format(node, fmt, args);
+
+  Isolate::current()->write(s->to_string());
+
+  return new ObjLong(s->value.length());
+}
+
+// import_native
+Object* bf_import_native(Node* node, ObjString* path)
+{
+  Isolate::current()->get_natives().load(
+      node, Utils::Converter::to_utf8(path->value));
+
+  return new ObjNone;
+}
+
+constinit BuiltinFunc const builtin_table[] = {
+    bind_builtin<bf_abs>("abs"),
+    bind_builtin<bf_append>("append"),
+    bind_builtin<bf_format>("format"),
+    bind_builtin<bf_vector>("vector"),
+    bind_builtin<bf_range>("range"),
+    bind_builtin<bf_channel>("channel"),
+    bind_builtin<bf_send>("send"),
+    bind_builtin<bf_recv>("recv"),
+    bind_builtin<bf_try_send>("try_send"),
+    bind_builtin<bf_try_recv>("try_recv"),
+    bind_builtin<bf_close>("close"),
+    bind_builtin<bf_print>("print"),
+    bind_builtin<bf_println>("println"),
+    bind_builtin<bf_printf>("printf"),
+    bind_builtin<bf_import_native>("import_native"),
 };
+
+}  // namespace
+
+std::span<BuiltinFunc const> const BuiltinFunc::builtin_functions =
+    builtin_table;
+
+BuiltinFunc const* BuiltinFunc::find(std::string_view name)
+{
+  for (auto&& bfun : builtin_functions) {
+    if (bfun.name == name) {
+      return &bfun;
+    }
+  }
+
+  return Isolate::current()->get_natives().find(name);
+}
+
+Object* BuiltinFunc::call_timed(Node* node, BF_Args args) const
+{
+  auto H = this->histogram.load(std::memory_order_acquire);
+
+  // (same histogram if created by other thread at once)
+  if (!H) {
+    H = &Metrics::histogram("builtin_seconds",
+                            Metrics::label("name", this->name));
+
+    this->histogram.store(H, std::memory_order_release);
+  }
+
+  Metrics::Timer timer{*H};
+
+  return this->call_direct(node, args);
+}
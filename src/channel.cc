@@ -0,0 +1,219 @@
+#include <algorithm>
+
+#include "Channel.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
+
+Channel::Channel(size_t capacity)
+    : cells(new Cell[std::max<size_t>(capacity, 2)]),
+      size(std::max<size_t>(capacity, 2)),
+      limit(capacity),
+      send_pos(0),
+      recv_pos(0),
+      closed(false),
+      version(0),
+      waiters(0)
+{
+  for (size_t i = 0; i < this->size; i++) {
+    this->cells[i].seq = i;
+    this->cells[i].value = nullptr;
+  }
+}
+
+size_t Channel::capacity() const
+{
+  return this->limit;
+}
+
+bool Channel::try_send(Object* value)
+{
+  auto pos = this->send_pos.load(std::memory_order_relaxed);
+  Cell* cell;
+
+  while (true) {
+    cell = &this->cells[pos % this->size];
+
+    auto seq = cell->seq.load(std::memory_order_acquire);
+    auto diff = (intptr_t)seq - (intptr_t)pos;
+
+    //
+    // (full, by the capacity)
+    if (pos - this->recv_pos.load(std::memory_order_acquire) >=
+        this->limit) {
+      return false;
+    }
+
+    //
+    // the cell is empty at pos
+    if (diff == 0) {
+      if (this->send_pos.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    // (not received yet)
+    else if (diff < 0) {
+      return false;
+    }
+
+    // (other thread has sent at pos)
+    else {
+      pos = this->send_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->value = value;
+  cell->seq.store(pos + 1, std::memory_order_release);
+
+  this->notify();
+
+  return true;
+}
+
+bool Channel::try_recv(Object*& value)
+{
+  auto pos = this->recv_pos.load(std::memory_order_relaxed);
+  Cell* cell;
+
+  while (true) {
+    cell = &this->cells[pos % this->size];
+
+    auto seq = cell->seq.load(std::memory_order_acquire);
+    auto diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    //
+    // the cell has a value at pos
+    if (diff == 0) {
+      if (this->recv_pos.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    // (not sent yet)
+    else if (diff < 0) {
+      return false;
+    }
+
+    // (other thread has received at pos)
+    else {
+      pos = this->recv_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  value = cell->value;
+
+  // the cell is reused at pos + size
+  cell->seq.store(pos + this->size, std::memory_order_release);
+
+  this->notify();
+
+  return true;
+}
+
+bool Channel::send(Object* value)
+{
+  while (!this->closed) {
+    auto ver = this->version.load();
+
+    if (this->try_send(value)) {
+      return true;
+    }
+
+    if (!this->wait(ver)) {
+      break;
+    }
+  }
+
+  return false;
+}
+
+bool Channel::recv(Object*& value)
+{
+  while (true) {
+    auto ver = this->version.load();
+
+    if (this->try_recv(value)) {
+      return true;
+    }
+
+    //
+    // (values sent before close are received above)
+    if (this->closed) {
+      return this->try_recv(value);
+    }
+
+    if (!this->wait(ver)) {
+      return false;
+    }
+  }
+}
+
+void Channel::close()
+{
+  this->closed = true;
+
+  this->notify();
+}
+
+bool Channel::is_closed() const
+{
+  return this->closed;
+}
+
+void Channel::for_each(std::function<void(Object*)> const& fn) const
+{
+  for (auto pos = this->recv_pos.load(); pos != this->send_pos.load();
+       pos++) {
+    fn(this->cells[pos % this->size].value);
+  }
+}
+
+bool Channel::can_block()
+{
+  return Scheduler::current() || ThreadPool::current();
+}
+
+bool Channel::wait(size_t ver)
+{
+  if (!can_block()) {
+    return false;
+  }
+
+  auto scheduler = Scheduler::current();
+
+  if (scheduler) {
+    scheduler->enter_blocking();
+  }
+
+  this->waiters++;
+
+  {
+    std::unique_lock<std::mutex> lock{this->mtx};
+
+    this->cv.wait(lock, [&] { return this->version != ver; });
+  }
+
+  this->waiters--;
+
+  if (scheduler) {
+    scheduler->leave_blocking();
+  }
+
+  return true;
+}
+
+void Channel::notify()
+{
+  this->version++;
+
+  //
+  // waiters is counted before the version is checked,
+  // so no thread misses the change.
+  if (this->waiters != 0) {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    this->cv.notify_all();
+  }
+}
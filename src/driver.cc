@@ -1,45 +1,294 @@
-#include "Lexer.h"
-#include "Parser.h"
-#include "Evaluator.h"
-#include "Driver.h"
-#include "GC.h"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
-static Driver* __inst;
+#include "types/Object.h"
+#include "Batch.h"
+#include "Driver.h"
+#include "Metrics.h"
+#include "Server.h"
 
 Driver::Driver()
+    : path("test.txt"),
+      serve_path(nullptr),
+      batch_dir(nullptr),
+      workers(std::max(std::thread::hardware_concurrency(), 1u)),
+      metrics_path(nullptr),
+      fork_count(0),
+      entry("main"),
+      snapshot_path(nullptr)
 {
-  __inst = this;
 }
 
-Object* Driver::execute_script()
+int Driver::main(int argc, char** argv)
 {
-  MetroGC gc;
+  if (!this->parse_args(argc, argv)) {
+    return 1;
+  }
+
+  if (this->serve_path || this->metrics_path) {
+    Metrics::enable();
+  }
+
+  auto code = this->run();
+
+  if (this->metrics_path &&
+      !Metrics::write_file(this->metrics_path)) {
+    std::cerr << "cannot write metrics: " << this->metrics_path
+              << std::endl;
+  }
+
+  return code;
+}
+
+int Driver::run()
+{
+  if (this->serve_path) {
+    Server server{this->options, this->workers};
+
+    return server.serve(this->serve_path) ? 0 : 1;
+  }
+
+  if (this->batch_dir) {
+    Batch batch{this->options, this->workers};
 
-  Lexer lexer{this->source};
+    return batch.run(this->batch_dir) ? 0 : 1;
+  }
 
-  auto token = lexer.lex();
+  if (this->fork_count) {
+    return this->run_forked();
+  }
 
-  Parser parser{token};
+  if (this->snapshot_path) {
+    return this->run_entry();
+  }
 
-  auto node = parser.parse();
+  Isolate isolate{this->options};
 
-  Evaluator eval{gc};
+  if (!isolate.load_file(this->path)) {
+    std::cerr << "cannot open file: " << this->path << std::endl;
+    return 1;
+  }
 
-  auto obj = eval.eval(node);
+  try {
+    isolate.execute();
+  }
+  catch (ScriptError const&) {
+    // (the error is shown already)
+    return 1;
+  }
 
-  return obj;
+  return 0;
 }
 
-int Driver::main(int argc, char** argv)
+int Driver::run_forked()
 {
-  this->source.readfile("test.txt");
+  Isolate isolate{this->options};
+
+  if (!isolate.load_file(this->path)) {
+    std::cerr << "cannot open file: " << this->path << std::endl;
+    return 1;
+  }
+
+  if (!this->initialize(isolate)) {
+    return 1;
+  }
+
+  size_t running = 0;
+  size_t failed = 0;
+
+  auto wait_one = [&running, &failed] {
+    int status;
+
+    if (wait(&status) == -1) {
+      return;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed++;
+    }
+
+    running--;
+  };
+
+  for (auto&& input : this->inputs) {
+    if (running == this->fork_count) {
+      wait_one();
+    }
+
+    auto pid = isolate.fork();
+
+    if (pid == -1) {
+      std::cerr << "cannot fork" << std::endl;
+      failed++;
+      break;
+    }
+
+    if (pid == 0) {
+      auto code = this->call_entry(isolate, input);
 
-  auto res = this->execute_script();
+      std::cout.flush();
+
+      // (not to run destructors of the copy of parent)
+      _exit(code);
+    }
+
+    running++;
+  }
+
+  while (running) {
+    wait_one();
+  }
+
+  return failed ? 1 : 0;
+}
+
+int Driver::run_entry()
+{
+  Isolate isolate{this->options};
+
+  if (!isolate.load_file(this->path)) {
+    std::cerr << "cannot open file: " << this->path << std::endl;
+    return 1;
+  }
+
+  if (!this->initialize(isolate)) {
+    return 1;
+  }
+
+  int code = 0;
+
+  for (auto&& input : this->inputs) {
+    code |= this->call_entry(isolate, input);
+  }
+
+  return code;
+}
+
+bool Driver::initialize(Isolate& isolate)
+{
+  auto snapshot = this->snapshot_path;
+
+  try {
+    if (snapshot && std::filesystem::exists(snapshot) &&
+        isolate.restore_snapshot(snapshot)) {
+      return true;
+    }
+
+    isolate.initialize();
+  }
+  catch (ScriptError const&) {
+    return false;
+  }
+
+  // (runs without it if cannot be saved)
+  if (snapshot) {
+    isolate.save_snapshot(snapshot);
+  }
+
+  return true;
+}
+
+int Driver::call_entry(Isolate& isolate, std::string const& input)
+{
+  try {
+    if (!isolate.call(this->entry, input)) {
+      std::cerr << "undefined function: " << this->entry
+                << std::endl;
+      return 1;
+    }
+  }
+  catch (ScriptError const&) {
+    return 1;
+  }
 
   return 0;
 }
 
-Source const& Driver::get_current_source()
+//
+// metro [options] [file] [inputs...]
+bool Driver::parse_args(int argc, char** argv)
 {
-  return __inst->source;
+  bool has_path = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+
+    if (arg == "--stackless") {
+      this->options.stackless = true;
+    }
+    else if (arg == "--unchecked") {
+      this->options.unchecked = true;
+    }
+    else if (arg == "--no-inline") {
+      this->options.inline_functions = false;
+    }
+    else if (arg == "--no-loop-opt") {
+      this->options.optimize_loops = false;
+    }
+    else if (arg == "--no-vectorize") {
+      this->options.vectorize_loops = false;
+    }
+    else if (arg == "--parallel") {
+      this->options.threads =
+          std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    else if (arg == "--threads" && i + 1 < argc) {
+      this->options.threads = std::stoul(argv[++i]);
+    }
+    else if (arg == "--inline-size" && i + 1 < argc) {
+      this->options.inline_size = std::stoul(argv[++i]);
+    }
+    else if (arg == "--max-frames" && i + 1 < argc) {
+      this->options.max_frames = std::stoul(argv[++i]);
+    }
+    else if (arg == "--max-steps" && i + 1 < argc) {
+      this->options.max_steps = std::stoull(argv[++i]);
+    }
+    else if (arg == "--timeout" && i + 1 < argc) {
+      this->options.timeout_ms = std::stoull(argv[++i]);
+    }
+    else if (arg == "--max-heap" && i + 1 < argc) {
+      this->options.max_heap = std::stoul(argv[++i]);
+    }
+    else if (arg == "--serve" && i + 1 < argc) {
+      this->serve_path = argv[++i];
+    }
+    else if (arg == "--batch" && i + 1 < argc) {
+      this->batch_dir = argv[++i];
+    }
+    else if ((arg == "--workers" || arg == "-j") && i + 1 < argc) {
+      this->workers = std::stoul(argv[++i]);
+    }
+    else if (arg == "--metrics" && i + 1 < argc) {
+      this->metrics_path = argv[++i];
+    }
+    else if (arg == "--fork" && i + 1 < argc) {
+      this->fork_count = std::max<size_t>(std::stoul(argv[++i]), 1);
+    }
+    else if (arg == "--entry" && i + 1 < argc) {
+      this->entry = argv[++i];
+    }
+    else if (arg == "--snapshot" && i + 1 < argc) {
+      this->snapshot_path = argv[++i];
+    }
+    else if (arg.starts_with("-")) {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    }
+    else if (!has_path) {
+      this->path = argv[i];
+      has_path = true;
+    }
+    else {
+      this->inputs.emplace_back(arg);
+    }
+  }
+
+  return true;
 }
@@ -1,11 +1,14 @@
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 #include "types/Token.h"
 #include "types/Node.h"
 
 #include "Utils.h"
-#include "Driver.h"
+#include "Isolate.h"
 
 #include "Error.h"
 
@@ -34,10 +37,32 @@ static constexpr std::pair<ErrorKind, char const*> error_msg_list[]{
     {ERR_InvalidRange, "invalid range"},
     {ERR_MayNotToBeEvaluated, "expression may not to be evaluated"},
     {ERR_CannotUseReturnHere, "cannot use 'return' here"},
+    {ERR_CannotUseBreakHere, "cannot use 'break' here"},
     {ERR_ValueOutOfRange, "value out of range"},
+    {ERR_StackOverflow, "stack overflow"},
+    {ERR_CannotLoadNative, "cannot load native module"},
+    {ERR_NativeError, "error in native function"},
+    {ERR_UnknownTypeName, "unknown type name"},
+    {ERR_AssignToSharedVariable,
+     "cannot assign to variable shared between threads"},
+    {ERR_SendToClosedChannel, "send to closed channel"},
+    {ERR_ChannelBlocksForever, "channel blocks forever"},
+    {ERR_DivisionByZero, "division by zero"},
+    {ERR_StepLimitExceeded, "step limit exceeded"},
+    {ERR_TimeLimitExceeded, "time limit exceeded"},
+    {ERR_HeapLimitExceeded, "heap limit exceeded"},
 };
 
-static size_t err_emitted_count{};
+//
+// errors are also emitted from threads of parallel for,
+// and from other isolates. (output is shared by process)
+static std::mutex emit_mutex;
+
+//
+// count of try blocks entered by the current thread.
+// errors in them are caught by script, or thrown again by
+// the thread waiting for this one, so not shown here.
+static thread_local size_t try_depth;
 
 static char const* get_err_msg(ErrorKind kind)
 {
@@ -128,6 +153,24 @@ static std::pair<Token*, Token*> get_token_range(Node* node)
       return {node->token,
               get_token_range(node->nd_return_expr).second};
 
+    case ND_Induction:
+      return get_token_range(node->nd_induction_expr);
+
+    case ND_Invariant:
+      return get_token_range(node->nd_invariant_expr);
+
+    case ND_Spawn:
+      return {node->token,
+              get_token_range(node->nd_spawn_call).second};
+
+    case ND_Try:
+      return {node->token,
+              get_token_range(node->nd_catch_code).second};
+
+    case ND_Await:
+      return {node->token,
+              get_token_range(node->nd_await_expr).second};
+
     default:
       auto first = get_token_range(node->nd_lhs).first;
       auto second = get_token_range(node->nd_rhs).second;
@@ -143,7 +186,7 @@ Error::ErrLocation::ErrLocation(size_t pos)
       end(0),
       pos(pos)
 {
-  auto const& source = Driver::get_current_source();
+  auto const& source = Isolate::current()->get_source();
 
   this->linenum = std::get<0>(source.get_line(pos));
 }
@@ -180,7 +223,7 @@ Error::ErrLocation::ErrLocation(Node* node)
 
 std::vector<std::string> Error::ErrLocation::trim_source() const
 {
-  auto const& source = Driver::get_current_source();
+  auto const& source = Isolate::current()->get_source();
 
   auto tbegin = std::get<1>(source.get_line(this->begin));
   auto tend = std::get<2>(source.get_line(this->end));
@@ -273,7 +316,7 @@ std::string Error::create_showing_text(ErrLocation const& loc,
 {
   std::stringstream ss;
 
-  auto const& source = Driver::get_current_source();
+  auto const& source = Isolate::current()->get_source();
   auto trimmed = loc.trim_source();
 
   ss << msg << std::endl
@@ -351,6 +394,8 @@ std::vector<Error::Suggestion*>* Error::_find_suggest(
 
 Error& Error::emit()
 {
+  std::lock_guard<std::mutex> lock{emit_mutex};
+
   auto const col = this->is_warn ? COL_YELLOW : COL_RED;
 
   auto msg = Utils::format(
@@ -358,19 +403,25 @@ Error& Error::emit()
       col, this->is_warn ? "warning" : "error",
       static_cast<int>(this->kind), col, get_err_msg(this->kind));
 
-  // show main message
-  std::cout << this->create_showing_text(this->loc, msg, EF_Main);
+  // main message
+  this->text = this->create_showing_text(this->loc, msg, EF_Main);
 
-  // show suggests
+  // suggests
   for (auto&& S : this->suggests) {
     if (!S._emitted) {
-      std::cout << this->create_showing_text(
+      this->text += this->create_showing_text(
           S.loc, COL_MAGENTA "help: " + S.msg, EF_Help);
     }
   }
 
+  if (try_depth != 0) {
+    return *this;
+  }
+
+  Isolate::current()->write(this->text);
+
   if (!this->is_warn) {
-    err_emitted_count++;
+    Isolate::current()->add_error(this->to_script_error());
   }
 
   return *this;
@@ -378,12 +429,82 @@ Error& Error::emit()
 
 void Error::check()
 {
-  if (err_emitted_count >= 10) {
-    std::exit(1);
+  if (auto& errors = Isolate::current()->get_errors();
+      !errors.empty()) {
+    throw errors[0];
   }
 }
 
-void Error::exit(int code)
+void Error::exit()
+{
+  throw this->to_script_error();
+}
+
+void Error::enter_try()
+{
+  try_depth++;
+}
+
+void Error::leave_try()
+{
+  try_depth--;
+}
+
+void Error::rethrow(std::exception_ptr error)
+{
+  try {
+    std::rethrow_exception(error);
+  }
+  catch (ScriptError const& err) {
+    std::lock_guard<std::mutex> lock{emit_mutex};
+
+    if (try_depth == 0) {
+      Isolate::current()->write(err.text);
+
+      Isolate::current()->add_error(ScriptError{err});
+    }
+
+    throw;
+  }
+}
+
+ScriptError Error::to_script_error() const
+{
+  auto const& source = Isolate::current()->get_source();
+
+  auto line_begin = std::get<1>(source.get_line(this->loc.begin));
+
+  auto err = ScriptError(this->kind, get_err_msg(this->kind),
+                         source.path, this->loc.linenum,
+                         this->loc.begin - line_begin + 1);
+
+  err.text = this->text;
+
+  return err;
+}
+
+ScriptError::ScriptError(ErrorKind kind, std::string message,
+                         std::string path, size_t line,
+                         size_t column)
+    : kind(kind),
+      message(std::move(message)),
+      path(std::move(path)),
+      line(line),
+      column(column)
+{
+  this->location = Utils::format("%s:%zu:%zu: %s",
+                                 this->path.c_str(), this->line,
+                                 this->column, this->message.c_str());
+}
+
+char const* ScriptError::what() const noexcept
+{
+  return this->location.c_str();
+}
+
+bool ScriptError::is_over_budget() const
 {
-  std::exit(code);
+  return this->kind == ERR_StepLimitExceeded ||
+         this->kind == ERR_TimeLimitExceeded ||
+         this->kind == ERR_HeapLimitExceeded;
 }
\ No newline at end of file
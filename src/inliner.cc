@@ -0,0 +1,427 @@
+#include <string>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "types/BuiltinFunc.h"
+#include "types/Source.h"
+#include "Utils.h"
+#include "Inliner.h"
+
+namespace {
+
+size_t count_nodes(Node* node)
+{
+  size_t n = 1;
+
+  node->each_child([&n](Node*& x) { n += count_nodes(x); });
+
+  return n;
+}
+
+//
+// callee is a builtin function bound by Resolver
+bool is_builtin_call(Node* node)
+{
+  auto functor = node->nd_callfunc_functor;
+
+  return functor->kind == ND_Variable && functor->nd_variable_func &&
+         ((ObjFunction*)functor->nd_variable_func)->is_builtin;
+}
+
+//
+// callee is a user function bound by Resolver
+Node* get_user_callee(Node* node)
+{
+  auto functor = node->nd_callfunc_functor;
+
+  if (functor->kind == ND_Variable && functor->nd_variable_func) {
+    if (auto obj = (ObjFunction*)functor->nd_variable_func;
+        !obj->is_builtin) {
+      return obj->func;
+    }
+  }
+
+  return nullptr;
+}
+
+bool has_kind(Node* node, NodeKind kind)
+{
+  auto found = node->kind == kind;
+
+  node->each_child(
+      [&](Node*& x) { found = found || has_kind(x, kind); });
+
+  return found;
+}
+
+size_t count_uses(Node* node, std::string_view name)
+{
+  size_t n = node->kind == ND_Variable && node->token->str == name;
+
+  node->each_child([&](Node*& x) { n += count_uses(x, name); });
+
+  return n;
+}
+
+}  // namespace
+
+Inliner::Inliner(Node* root, Source& source, size_t max_size)
+    : root(root),
+      source(source),
+      max_size(max_size),
+      count(0)
+{
+}
+
+void Inliner::inline_all()
+{
+  this->walk(this->root);
+}
+
+void Inliner::walk(Node*& node)
+{
+  if (node->kind == ND_Function) {
+    this->prepare(node);
+    return;
+  }
+
+  //
+  // the call of spawn runs on a task as is
+  // (only the arguments are inlined)
+  if (node->kind == ND_Spawn) {
+    for (auto&& x : node->nd_spawn_call->list) {
+      this->walk(x);
+    }
+
+    return;
+  }
+
+  node->each_child([this](Node*& x) { this->walk(x); });
+
+  if (node->kind != ND_Callfunc) {
+    return;
+  }
+
+  if (auto func = get_user_callee(node); func) {
+    this->prepare(func);
+
+    if (this->states[func] == ST_Inlinable &&
+        node->list.size() == func->list.size()) {
+      node = this->expand(node, func);
+    }
+  }
+}
+
+//
+// inline the calls in body of func, and check func itself
+void Inliner::prepare(Node* func)
+{
+  auto& state = this->states[func];
+
+  if (state != ST_None) {
+    return;
+  }
+
+  state = ST_Visiting;
+
+  this->walk(func->nd_func_code);
+
+  this->states[func] =
+      this->is_inlinable(func) ? ST_Inlinable : ST_NotInlinable;
+}
+
+bool Inliner::is_inlinable(Node* func)
+{
+  auto body = func->nd_func_code;
+
+  for (auto&& arg : func->list) {
+    if (arg->kind == ND_VariableArguments) {
+      return false;
+    }
+  }
+
+  if (body->list.empty() || (*body->list.rbegin())->kind == ND_None) {
+    return false;
+  }
+
+  return count_nodes(body) <= this->max_size &&
+         this->check_body(body, true);
+}
+
+//
+// is_tail: node is evaluated as return value of function
+bool Inliner::check_body(Node* node, bool is_tail)
+{
+  switch (node->kind) {
+    case ND_Function:
+    case ND_SelfFunc:
+    case ND_Break:
+    case ND_Continue:
+    case ND_Struct:
+    case ND_Namespace:
+    case ND_Try:  // (variable of catch is not renamed)
+      return false;
+
+    case ND_Return:
+      return is_tail && node->nd_return_expr &&
+             this->check_body(node->nd_return_expr, false);
+
+    case ND_Callfunc:
+      if (!is_builtin_call(node)) {
+        return false;
+      }
+
+      break;
+
+    case ND_If:
+      if (is_tail) {
+        return this->check_body(node->nd_if_cond, false) &&
+               this->check_body(node->nd_if_true, true) &&
+               (!node->nd_if_false ||
+                this->check_body(node->nd_if_false, true));
+      }
+
+      break;
+
+    case ND_Scope:
+      if (is_tail) {
+        for (auto&& x : node->list) {
+          if (!this->check_body(x, x == *node->list.rbegin())) {
+            return false;
+          }
+        }
+
+        return true;
+      }
+
+      break;
+  }
+
+  auto ok = true;
+
+  node->each_child(
+      [&](Node*& x) { ok = ok && this->check_body(x, false); });
+
+  return ok;
+}
+
+//
+// create the node which replaces call
+Node* Inliner::expand(Node* call, Node* func)
+{
+  auto body = func->nd_func_code;
+
+  this->count++;
+
+  //
+  // arguments which have no side effect are substituted directly,
+  // if the body is a single expression without assignment.
+  auto is_direct = body->list.size() == 1 &&
+                   !func->nd_func_return_type &&
+                   !has_kind(body, ND_Assign) &&
+                   !has_kind(body, ND_Let) &&
+                   !has_kind(body, ND_Callfunc) &&
+                   !has_kind(body, ND_For);
+
+  for (size_t i = 0; is_direct && i < call->list.size(); i++) {
+    auto arg = call->list[i];
+    auto formal = func->list[i];
+
+    // (don't skip the error of uninitialized variable)
+    is_direct = !formal->nd_arg_type &&
+                (arg->kind == ND_Value ||
+                 (arg->kind == ND_Variable &&
+                  count_uses(body, formal->nd_arg_name->str) != 0));
+  }
+
+  if (is_direct) {
+    for (size_t i = 0; i < call->list.size(); i++) {
+      this->substitutes[func->list[i]->nd_arg_name->str] =
+          call->list[i];
+    }
+
+    auto ret = this->strip_return(this->clone(body->list[0]));
+
+    this->substitutes.clear();
+
+    return ret;
+  }
+
+  //
+  // { let arg@N = ...; ...; { body } }
+  // (body has its own scope as called, so a let of the
+  //  name of an argument defines another variable)
+  auto scope = new Node(ND_Scope, call->token);
+
+  for (size_t i = 0; i < call->list.size(); i++) {
+    auto formal = func->list[i];
+    auto let = new Node(ND_Let, call->token);
+
+    let->nd_let_name = this->rename(formal->nd_arg_name);
+    let->nd_let_type = formal->nd_arg_type;
+    let->nd_let_init = call->list[i];
+
+    scope->append(let);
+  }
+
+  scope->append(this->clone(body));
+
+  auto& last = *scope->list.rbegin();
+
+  last = this->strip_return(last);
+
+  //
+  // check the type of return value by let
+  if (auto T = func->nd_func_return_type; T) {
+    auto let = new Node(ND_Let, call->token);
+    auto result = new Node(ND_Variable, call->token);
+
+    let->nd_let_name = this->rename(func->nd_func_name);
+    let->nd_let_type = T;
+    let->nd_let_init = last;
+
+    result->token = result->nd_variable_name = let->nd_let_name;
+
+    last = let;
+    scope->append(result);
+  }
+
+  this->renames.clear();
+
+  return scope;
+}
+
+Node* Inliner::clone(Node* node)
+{
+  if (!node) {
+    return nullptr;
+  }
+
+  auto x = new Node(*node);
+
+  //
+  // token at the location of the use, with other name
+  // (errors are reported there, as not inlined)
+  auto use_token = [node](std::string_view str) {
+    auto tok = new Token(*node->token);
+
+    tok->str = str;
+
+    return tok;
+  };
+
+  switch (x->kind) {
+    case ND_Variable: {
+      if (auto tok = this->find_rename(x->token->str); tok) {
+        x->token = x->nd_variable_name = use_token(tok->str);
+      }
+      else if (auto it = this->substitutes.find(x->token->str);
+               it != this->substitutes.end()) {
+        // argument is a leaf (ND_Value or ND_Variable)
+        *x = *it->second;
+
+        x->token = use_token(it->second->token->str);
+
+        if (x->kind == ND_Variable) {
+          x->nd_variable_name = x->token;
+        }
+      }
+
+      break;
+    }
+
+    case ND_Let:
+      // variable is defined before initializer is evaluated
+      x->nd_let_name = this->rename(x->nd_let_name);
+      x->nd_let_init = this->clone(x->nd_let_init);
+      break;
+
+    case ND_Scope: {
+      auto base = this->renames.size();
+
+      for (auto&& e : x->list) {
+        e = this->clone(e);
+      }
+
+      this->renames.resize(base);
+      break;
+    }
+
+    case ND_For: {
+      auto base = this->renames.size();
+
+      x->nd_for_range = this->clone(x->nd_for_range);
+
+      if (x->nd_for_iterator->kind == ND_Variable) {
+        this->rename(x->nd_for_iterator->nd_variable_name);
+      }
+
+      x->nd_for_iterator = this->clone(x->nd_for_iterator);
+      x->nd_for_loop_code = this->clone(x->nd_for_loop_code);
+
+      this->renames.resize(base);
+      break;
+    }
+
+    default:
+      x->each_child([this](Node*& c) { c = this->clone(c); });
+      break;
+  }
+
+  return x;
+}
+
+//
+// remove return statements on tail of body
+Node* Inliner::strip_return(Node* node)
+{
+  switch (node->kind) {
+    case ND_Return:
+      return node->nd_return_expr;
+
+    case ND_If:
+      node->nd_if_true = this->strip_return(node->nd_if_true);
+
+      if (node->nd_if_false) {
+        node->nd_if_false = this->strip_return(node->nd_if_false);
+      }
+
+      break;
+
+    case ND_Scope:
+      if (!node->list.empty()) {
+        auto& last = *node->list.rbegin();
+
+        last = this->strip_return(last);
+      }
+
+      break;
+  }
+
+  return node;
+}
+
+Token* Inliner::rename(Token* token)
+{
+  auto tok = new Token(*token);
+
+  tok->str = this->source.names.emplace_back(
+      std::string(token->str) + "@" + std::to_string(this->count));
+
+  this->renames.emplace_back(token->str, tok);
+
+  return tok;
+}
+
+Token* Inliner::find_rename(std::string_view name)
+{
+  for (auto it = this->renames.rbegin(); it != this->renames.rend();
+       it++) {
+    if (it->first == name) {
+      return it->second;
+    }
+  }
+
+  return nullptr;
+}
@@ -0,0 +1,478 @@
+#include <iostream>
+
+#include <unistd.h>
+
+#include "types/Node.h"
+#include "types/Object.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "TypeChecker.h"
+#include "LoopOptimizer.h"
+#include "Evaluator.h"
+#include "Utils.h"
+#include "Channel.h"
+#include "Metrics.h"
+#include "Snapshot.h"
+#include "Isolate.h"
+
+namespace {
+
+//
+// isolate entered by the thread running now
+thread_local Isolate* cur_isolate;
+
+}  // namespace
+
+Isolate::Scope::Scope(Isolate* isolate)
+    : prev(cur_isolate)
+{
+  cur_isolate = isolate;
+}
+
+Isolate::Scope::~Scope()
+{
+  cur_isolate = this->prev;
+}
+
+Isolate::Isolate()
+    : Isolate(Options{})
+{
+}
+
+Isolate::Isolate(Options const& options)
+    : options(options),
+      output(&std::cout),
+      program(nullptr),
+      call_mark(0),
+      program_mark(0),
+      sweep_at(0),
+      has_globals(false)
+{
+}
+
+Isolate::~Isolate()
+{
+  Scope scope{this};
+
+  // (tasks may use objects in the heap)
+  this->evaluator.reset();
+
+  this->heap.stop();
+}
+
+bool Isolate::load_file(char const* path)
+{
+  return this->source.readfile(path);
+}
+
+void Isolate::load_string(std::string const& text, char const* name)
+{
+  this->source.path = name;
+  this->source.text = text;
+
+  // (every line ends with '\n', as read by Source::readfile)
+  if (!text.ends_with('\n')) {
+    this->source.text += '\n';
+  }
+
+  this->source.init_line_list();
+}
+
+void Isolate::compile()
+{
+  if (this->program) {
+    return;
+  }
+
+  Scope scope{this};
+
+  Metrics::Timer timer{Metrics::histogram(
+      "compile_seconds", Metrics::label("path", this->source.path))};
+
+  this->errors.clear();
+
+  Lexer lexer{this->source};
+
+  auto token = lexer.lex();
+
+  Parser parser{token};
+
+  auto node = parser.parse();
+
+  Resolver resolver{node};
+
+  resolver.resolve();
+
+  if (this->options.inline_functions) {
+    Inliner inliner{node, this->source, this->options.inline_size};
+
+    inliner.inline_all();
+  }
+
+  if (this->options.optimize_loops) {
+    LoopOptimizer optimizer{node, this->source,
+                            this->options.vectorize_loops};
+
+    optimizer.optimize();
+  }
+
+  TypeChecker checker{node};
+
+  checker.check();
+
+  this->evaluator.reset(new Evaluator(this->heap));
+
+  this->evaluator->set_unchecked(this->options.unchecked);
+  this->evaluator->set_threads(this->options.threads);
+  this->evaluator->set_max_frames(this->options.max_frames);
+
+  this->heap.set_limit(this->options.max_heap);
+
+  this->program = node;
+
+  this->call_mark = this->heap.mark();
+  this->program_mark = this->call_mark;
+}
+
+Object* Isolate::execute()
+{
+  Scope scope{this};
+
+  // (variables kept by initialize are dropped)
+  if (this->has_globals) {
+    this->evaluator->reset();
+    this->has_globals = false;
+  }
+
+  this->prepare();
+
+  try {
+    if (this->options.stackless) {
+      return this->evaluator->eval_stackless(this->program);
+    }
+
+    return this->evaluator->eval(this->program);
+  }
+  catch (ScriptError const&) {
+    this->abort();
+    throw;
+  }
+}
+
+Object* Isolate::initialize()
+{
+  Scope scope{this};
+
+  if (this->has_globals) {
+    this->evaluator->reset();
+    this->has_globals = false;
+  }
+
+  this->prepare();
+
+  try {
+    auto result = this->evaluator->eval_globals(
+        this->program, this->options.stackless);
+
+    this->evaluator->wait_tasks();
+
+    this->has_globals = true;
+    this->sweep_at = 0;
+
+    return result;
+  }
+  catch (ScriptError const&) {
+    this->abort();
+    throw;
+  }
+}
+
+pid_t Isolate::fork()
+{
+  Scope scope{this};
+
+  this->compile();
+
+  this->evaluator->wait_tasks();
+  this->evaluator->set_threads(1);
+
+  // (or written by both processes)
+  {
+    std::lock_guard<std::mutex> lock{this->output_mutex};
+
+    this->output->flush();
+  }
+
+  std::cout.flush();
+  std::cerr.flush();
+
+  auto pid = ::fork();
+
+  if (pid == 0) {
+    this->evaluator->set_threads(this->options.threads);
+  }
+
+  return pid;
+}
+
+bool Isolate::save_snapshot(char const* path)
+{
+  if (!this->has_globals) {
+    return false;
+  }
+
+  return Snapshot::write(
+      path, Snapshot::hash_of(this->source, this->options),
+      this->program, this->evaluator->get_globals());
+}
+
+bool Isolate::restore_snapshot(char const* path)
+{
+  Scope scope{this};
+
+  if (this->has_globals) {
+    this->evaluator->reset();
+    this->has_globals = false;
+  }
+
+  this->prepare();
+
+  Snapshot::Globals vars;
+
+  if (!Snapshot::read(path,
+                      Snapshot::hash_of(this->source, this->options),
+                      this->program, vars)) {
+    return false;
+  }
+
+  this->evaluator->set_globals(this->program, vars);
+
+  this->has_globals = true;
+  this->sweep_at = 0;
+
+  return true;
+}
+
+void Isolate::prepare()
+{
+  static auto& gc_pause = Metrics::histogram("gc_pause_seconds");
+
+  this->compile();
+
+  this->evaluator->wait_tasks();
+
+  // objects of the previous call may be referred by the
+  // variables kept by initialize, so they are swept instead.
+  if (!this->has_globals) {
+    Metrics::Timer timer{gc_pause};
+
+    this->heap.release(this->call_mark);
+  }
+  else if (this->heap.size() >= this->sweep_at) {
+    Metrics::Timer timer{gc_pause};
+
+    this->sweep();
+  }
+
+  this->call_mark = this->heap.mark();
+
+  this->errors.clear();
+
+  this->evaluator->set_budget(
+      this->options.max_steps,
+      std::chrono::milliseconds{this->options.timeout_ms});
+}
+
+void Isolate::sweep()
+{
+  // objects created after the last sweep, at least
+  static constexpr size_t interval = 4096;
+
+  std::vector<Object*> roots;
+
+  for (auto&& [name, value] : this->evaluator->get_globals()) {
+    roots.emplace_back(value);
+  }
+
+  this->heap.sweep(this->program_mark, roots);
+
+  // (when objects left are doubled)
+  auto size = this->heap.size();
+
+  this->sweep_at =
+      size + std::max(size - this->program_mark, interval);
+}
+
+ObjFunction* Isolate::prepare_call(std::string_view name)
+{
+  this->prepare();
+
+  for (auto&& x : this->program->list) {
+    if (x->kind == ND_Function && x->nd_func_name->str == name) {
+      return (ObjFunction*)x->nd_func_object;
+    }
+  }
+
+  return nullptr;
+}
+
+Object* Isolate::call_values(std::string_view name,
+                             std::vector<Value> const& args)
+{
+  Scope scope{this};
+
+  auto func = this->prepare_call(name);
+
+  if (!func) {
+    return nullptr;
+  }
+
+  std::vector<Object*> objects;
+
+  for (auto&& x : args) {
+    objects.emplace_back(
+        std::visit([](auto const& v) { return to_object(v); }, x));
+  }
+
+  return this->invoke(func, objects);
+}
+
+Object* Isolate::invoke(ObjFunction* func,
+                        std::vector<Object*> const& args)
+{
+  try {
+    auto result = this->evaluator->invoke(this->program, func, args,
+                                          this->options.stackless);
+
+    this->evaluator->wait_tasks();
+
+    return result;
+  }
+  catch (ScriptError const&) {
+    this->abort();
+    throw;
+  }
+}
+
+void Isolate::abort()
+{
+  std::vector<std::shared_ptr<Channel>> channels;
+
+  // (closed after the heap is unlocked)
+  this->heap.for_each([&channels](Object* obj) {
+    if (obj->type.kind == TYPE_Channel) {
+      channels.emplace_back(((ObjChannel*)obj)->channel);
+    }
+  });
+
+  for (auto&& ch : channels) {
+    ch->close();
+  }
+
+  this->evaluator->wait_tasks();
+
+  //
+  // variables kept by initialize are kept again, so that
+  // the next call can run. (as changed by this run)
+  auto globals = this->evaluator->get_globals();
+
+  this->evaluator->reset();
+
+  if (this->has_globals) {
+    this->evaluator->set_globals(this->program, globals);
+  }
+}
+
+Object* Isolate::to_object(Object* obj)
+{
+  return obj;
+}
+
+Object* Isolate::to_object(bool value)
+{
+  return new ObjBool(value);
+}
+
+Object* Isolate::to_object(double value)
+{
+  return new ObjFloat(value);
+}
+
+Object* Isolate::to_object(char const* str)
+{
+  return to_object(std::string_view{str});
+}
+
+Object* Isolate::to_object(std::string_view str)
+{
+  return new ObjString(Utils::Converter::to_wide(std::string{str}));
+}
+
+Object* Isolate::make_int(int64_t value)
+{
+  return new ObjLong(value);
+}
+
+Object* Isolate::make_vector(std::vector<Object*>&& elements)
+{
+  auto vec = new ObjVector;
+
+  vec->elements = std::move(elements);
+  vec->update_size();
+
+  return vec;
+}
+
+Source const& Isolate::get_source() const
+{
+  return this->source;
+}
+
+MetroGC& Isolate::get_heap()
+{
+  return this->heap;
+}
+
+NativeModule& Isolate::get_natives()
+{
+  return this->natives;
+}
+
+void Isolate::set_output(std::ostream& out)
+{
+  std::lock_guard<std::mutex> lock{this->output_mutex};
+
+  this->output = &out;
+}
+
+void Isolate::write(std::string_view text)
+{
+  std::lock_guard<std::mutex> lock{this->output_mutex};
+
+  *this->output << text;
+
+  if (text.ends_with('\n')) {
+    this->output->flush();
+  }
+}
+
+void Isolate::add_error(ScriptError&& err)
+{
+  this->errors.emplace_back(std::move(err));
+}
+
+bool Isolate::is_initialized() const
+{
+  return this->has_globals;
+}
+
+std::vector<ScriptError> const& Isolate::get_errors() const
+{
+  return this->errors;
+}
+
+Isolate* Isolate::current()
+{
+  return cur_isolate;
+}
@@ -0,0 +1,415 @@
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "Kernel.h"
+
+namespace {
+
+enum InstSet {
+  IS_Scalar,
+  IS_SSE2,
+  IS_AVX2,
+};
+
+InstSet detect_inst_set()
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return IS_AVX2;
+  }
+
+  // (always available in x86-64)
+  return IS_SSE2;
+#else
+  return IS_Scalar;
+#endif
+}
+
+InstSet get_inst_set()
+{
+  static auto const inst_set = detect_inst_set();
+
+  return inst_set;
+}
+
+//
+// also used for the rest of SIMD kernels
+template <class T>
+bool compute_scalar(NodeKind kind, T* dest, T const* a, T const* b,
+                    size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    if (is_overflow(kind, a[i], b[i])) {
+      return false;
+    }
+
+    switch (kind) {
+      case ND_Add:
+        dest[i] = a[i] + b[i];
+        break;
+
+      case ND_Sub:
+        dest[i] = a[i] - b[i];
+        break;
+
+      case ND_Mul:
+        dest[i] = a[i] * b[i];
+        break;
+
+      default:
+        if constexpr (std::is_integral_v<T>) {
+          switch (kind) {
+            case ND_BitAnd:
+              dest[i] = a[i] & b[i];
+              break;
+
+            case ND_BitXor:
+              dest[i] = a[i] ^ b[i];
+              break;
+
+            case ND_BitOr:
+              dest[i] = a[i] | b[i];
+              break;
+          }
+        }
+        else {
+          dest[i] = a[i] / b[i];
+        }
+    }
+  }
+
+  return true;
+}
+
+#if defined(__x86_64__)
+
+//
+// overflow of int64 is detected by sign bits:
+//   add: sign of result differs from both operands
+//   sub: signs of operands differ, and result differs from a
+//
+// (sub reports "0 - min" as overflow, which compute_expr
+//  doesn't. the batch is evaluated again without kernel.)
+
+__attribute__((target("avx2"))) bool compute_avx2(NodeKind kind,
+                                                  int64_t* dest,
+                                                  int64_t const* a,
+                                                  int64_t const* b,
+                                                  size_t count)
+{
+  auto overflow = _mm256_setzero_si256();
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    auto x = _mm256_loadu_si256((__m256i const*)(a + i));
+    auto y = _mm256_loadu_si256((__m256i const*)(b + i));
+    __m256i r;
+
+    switch (kind) {
+      case ND_Add:
+        r = _mm256_add_epi64(x, y);
+        overflow = _mm256_or_si256(
+            overflow, _mm256_and_si256(_mm256_xor_si256(x, r),
+                                       _mm256_xor_si256(y, r)));
+        break;
+
+      case ND_Sub:
+        r = _mm256_sub_epi64(x, y);
+        overflow = _mm256_or_si256(
+            overflow, _mm256_and_si256(_mm256_xor_si256(x, y),
+                                       _mm256_xor_si256(x, r)));
+        break;
+
+      case ND_BitAnd:
+        r = _mm256_and_si256(x, y);
+        break;
+
+      case ND_BitXor:
+        r = _mm256_xor_si256(x, y);
+        break;
+
+      default:
+        r = _mm256_or_si256(x, y);
+        break;
+    }
+
+    _mm256_storeu_si256((__m256i*)(dest + i), r);
+  }
+
+  if (_mm256_movemask_pd(_mm256_castsi256_pd(overflow))) {
+    return false;
+  }
+
+  return compute_scalar(kind, dest + i, a + i, b + i, count - i);
+}
+
+bool compute_sse2(NodeKind kind, int64_t* dest, int64_t const* a,
+                  int64_t const* b, size_t count)
+{
+  auto overflow = _mm_setzero_si128();
+  size_t i = 0;
+
+  for (; i + 2 <= count; i += 2) {
+    auto x = _mm_loadu_si128((__m128i const*)(a + i));
+    auto y = _mm_loadu_si128((__m128i const*)(b + i));
+    __m128i r;
+
+    switch (kind) {
+      case ND_Add:
+        r = _mm_add_epi64(x, y);
+        overflow = _mm_or_si128(
+            overflow,
+            _mm_and_si128(_mm_xor_si128(x, r), _mm_xor_si128(y, r)));
+        break;
+
+      case ND_Sub:
+        r = _mm_sub_epi64(x, y);
+        overflow = _mm_or_si128(
+            overflow,
+            _mm_and_si128(_mm_xor_si128(x, y), _mm_xor_si128(x, r)));
+        break;
+
+      case ND_BitAnd:
+        r = _mm_and_si128(x, y);
+        break;
+
+      case ND_BitXor:
+        r = _mm_xor_si128(x, y);
+        break;
+
+      default:
+        r = _mm_or_si128(x, y);
+        break;
+    }
+
+    _mm_storeu_si128((__m128i*)(dest + i), r);
+  }
+
+  if (_mm_movemask_pd(_mm_castsi128_pd(overflow))) {
+    return false;
+  }
+
+  return compute_scalar(kind, dest + i, a + i, b + i, count - i);
+}
+
+//
+// overflow of float is same condition as is_overflow<float>,
+// computed for all lanes.
+// (comparison with NaN is false, as in scalar)
+
+__attribute__((target("avx2"))) bool compute_avx2(NodeKind kind,
+                                                  float* dest,
+                                                  float const* a,
+                                                  float const* b,
+                                                  size_t count)
+{
+  auto const zero = _mm256_setzero_ps();
+  auto const max = _mm256_set1_ps(std::numeric_limits<float>::max());
+  auto const min = _mm256_set1_ps(std::numeric_limits<float>::min());
+
+  auto overflow = _mm256_setzero_ps();
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    auto x = _mm256_loadu_ps(a + i);
+    auto y = _mm256_loadu_ps(b + i);
+
+    auto xp = _mm256_cmp_ps(x, zero, _CMP_GT_OQ);
+    auto xn = _mm256_cmp_ps(x, zero, _CMP_LT_OQ);
+    auto yp = _mm256_cmp_ps(y, zero, _CMP_GT_OQ);
+    auto yn = _mm256_cmp_ps(y, zero, _CMP_LT_OQ);
+
+    __m256 r, o;
+
+    switch (kind) {
+      case ND_Add:
+        r = _mm256_add_ps(x, y);
+        o = _mm256_or_ps(
+            _mm256_and_ps(_mm256_and_ps(xp, yp),
+                          _mm256_cmp_ps(x, _mm256_sub_ps(max, y),
+                                        _CMP_GT_OQ)),
+            _mm256_and_ps(_mm256_and_ps(xn, yn),
+                          _mm256_cmp_ps(x, _mm256_sub_ps(min, y),
+                                        _CMP_LT_OQ)));
+        break;
+
+      case ND_Sub:
+        r = _mm256_sub_ps(x, y);
+        o = _mm256_or_ps(
+            _mm256_and_ps(_mm256_and_ps(xp, yn),
+                          _mm256_cmp_ps(x, _mm256_add_ps(max, y),
+                                        _CMP_GT_OQ)),
+            _mm256_and_ps(_mm256_and_ps(xn, yp),
+                          _mm256_cmp_ps(x, _mm256_add_ps(min, y),
+                                        _CMP_LT_OQ)));
+        break;
+
+      case ND_Mul:
+        r = _mm256_mul_ps(x, y);
+        o = _mm256_or_ps(
+            _mm256_or_ps(
+                _mm256_and_ps(_mm256_and_ps(xp, yp),
+                              _mm256_cmp_ps(x, _mm256_div_ps(max, y),
+                                            _CMP_GT_OQ)),
+                _mm256_and_ps(_mm256_and_ps(xp, yn),
+                              _mm256_cmp_ps(y, _mm256_div_ps(min, x),
+                                            _CMP_LT_OQ))),
+            _mm256_or_ps(
+                _mm256_and_ps(_mm256_and_ps(xn, yp),
+                              _mm256_cmp_ps(x, _mm256_div_ps(min, y),
+                                            _CMP_LT_OQ)),
+                _mm256_and_ps(_mm256_and_ps(xn, yn),
+                              _mm256_cmp_ps(y, _mm256_div_ps(max, x),
+                                            _CMP_LT_OQ))));
+        break;
+
+      default:
+        r = _mm256_div_ps(x, y);
+        o = zero;
+        break;
+    }
+
+    overflow = _mm256_or_ps(overflow, o);
+
+    _mm256_storeu_ps(dest + i, r);
+  }
+
+  if (_mm256_movemask_ps(overflow)) {
+    return false;
+  }
+
+  return compute_scalar(kind, dest + i, a + i, b + i, count - i);
+}
+
+bool compute_sse2(NodeKind kind, float* dest, float const* a,
+                  float const* b, size_t count)
+{
+  auto const zero = _mm_setzero_ps();
+  auto const max = _mm_set1_ps(std::numeric_limits<float>::max());
+  auto const min = _mm_set1_ps(std::numeric_limits<float>::min());
+
+  auto overflow = _mm_setzero_ps();
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    auto x = _mm_loadu_ps(a + i);
+    auto y = _mm_loadu_ps(b + i);
+
+    auto xp = _mm_cmpgt_ps(x, zero);
+    auto xn = _mm_cmplt_ps(x, zero);
+    auto yp = _mm_cmpgt_ps(y, zero);
+    auto yn = _mm_cmplt_ps(y, zero);
+
+    __m128 r, o;
+
+    switch (kind) {
+      case ND_Add:
+        r = _mm_add_ps(x, y);
+        o = _mm_or_ps(
+            _mm_and_ps(_mm_and_ps(xp, yp),
+                       _mm_cmpgt_ps(x, _mm_sub_ps(max, y))),
+            _mm_and_ps(_mm_and_ps(xn, yn),
+                       _mm_cmplt_ps(x, _mm_sub_ps(min, y))));
+        break;
+
+      case ND_Sub:
+        r = _mm_sub_ps(x, y);
+        o = _mm_or_ps(
+            _mm_and_ps(_mm_and_ps(xp, yn),
+                       _mm_cmpgt_ps(x, _mm_add_ps(max, y))),
+            _mm_and_ps(_mm_and_ps(xn, yp),
+                       _mm_cmplt_ps(x, _mm_add_ps(min, y))));
+        break;
+
+      case ND_Mul:
+        r = _mm_mul_ps(x, y);
+        o = _mm_or_ps(
+            _mm_or_ps(
+                _mm_and_ps(_mm_and_ps(xp, yp),
+                           _mm_cmpgt_ps(x, _mm_div_ps(max, y))),
+                _mm_and_ps(_mm_and_ps(xp, yn),
+                           _mm_cmplt_ps(y, _mm_div_ps(min, x)))),
+            _mm_or_ps(
+                _mm_and_ps(_mm_and_ps(xn, yp),
+                           _mm_cmplt_ps(x, _mm_div_ps(min, y))),
+                _mm_and_ps(_mm_and_ps(xn, yn),
+                           _mm_cmplt_ps(y, _mm_div_ps(max, x)))));
+        break;
+
+      default:
+        r = _mm_div_ps(x, y);
+        o = zero;
+        break;
+    }
+
+    overflow = _mm_or_ps(overflow, o);
+
+    _mm_storeu_ps(dest + i, r);
+  }
+
+  if (_mm_movemask_ps(overflow)) {
+    return false;
+  }
+
+  return compute_scalar(kind, dest + i, a + i, b + i, count - i);
+}
+
+#endif
+
+template <class T>
+bool dispatch(NodeKind kind, T* dest, T const* a, T const* b,
+              size_t count)
+{
+#if defined(__x86_64__)
+  switch (get_inst_set()) {
+    case IS_AVX2:
+      return compute_avx2(kind, dest, a, b, count);
+
+    case IS_SSE2:
+      return compute_sse2(kind, dest, a, b, count);
+  }
+#endif
+
+  return compute_scalar(kind, dest, a, b, count);
+}
+
+}  // namespace
+
+namespace Kernel {
+
+bool compute(NodeKind kind, int64_t* dest, int64_t const* a,
+             int64_t const* b, size_t count)
+{
+  switch (kind) {
+    case ND_Add:
+    case ND_Sub:
+    case ND_BitAnd ... ND_BitOr:
+      return dispatch(kind, dest, a, b, count);
+
+    //
+    // no instruction of 64-bit multiply in AVX2
+    case ND_Mul:
+      return compute_scalar(kind, dest, a, b, count);
+  }
+
+  // (division is left to compute_expr)
+  return false;
+}
+
+bool compute(NodeKind kind, float* dest, float const* a,
+             float const* b, size_t count)
+{
+  switch (kind) {
+    case ND_Add ... ND_Div:
+      return dispatch(kind, dest, a, b, count);
+  }
+
+  return false;
+}
+
+}  // namespace Kernel
@@ -81,6 +81,7 @@ static std::string_view const keywords[]{
     "switch",
     "match",
     "for",
+    "parallel",
     "loop",
     "while",
     "do",
@@ -88,6 +89,14 @@ static std::string_view const keywords[]{
     "continue",
     "return",
 
+    // task
+    "spawn",
+    "await",
+
+    // error
+    "try",
+    "catch",
+
     // variable declaration
     "let",
 
@@ -0,0 +1,573 @@
+#include <string>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "types/BuiltinFunc.h"
+#include "types/Source.h"
+#include "Utils.h"
+#include "LoopOptimizer.h"
+
+namespace {
+
+//
+// builtin function bound by Resolver (or null)
+BuiltinFunc const* get_builtin(Node* node)
+{
+  auto functor = node->nd_callfunc_functor;
+
+  if (functor->kind == ND_Variable && functor->nd_variable_func) {
+    if (auto obj = (ObjFunction*)functor->nd_variable_func;
+        obj->is_builtin) {
+      return obj->builtin;
+    }
+  }
+
+  return nullptr;
+}
+
+//
+// builtin function which keeps the arguments
+// (vector elements, values in channel)
+bool is_storing(BuiltinFunc const* bfun)
+{
+  std::string_view name = bfun->name;
+
+  return name == "append" || name == "vector" || name == "send" ||
+         name == "try_send";
+}
+
+bool has_jump(Node* node)
+{
+  auto found = node->kind == ND_Break || node->kind == ND_Continue ||
+               node->kind == ND_Return;
+
+  node->each_child([&](Node*& x) { found = found || has_jump(x); });
+
+  return found;
+}
+
+bool is_leaf(Node* node)
+{
+  switch (node->kind) {
+    case ND_Value:
+    case ND_True:
+    case ND_False:
+    case ND_Variable:
+      return true;
+  }
+
+  return false;
+}
+
+}  // namespace
+
+LoopOptimizer::LoopOptimizer(Node* root, Source& source,
+                             bool vectorize)
+    : root(root),
+      source(source),
+      vectorize(vectorize),
+      loop(nullptr),
+      has_call(false),
+      has_write(false),
+      has_resize(false),
+      count(0)
+{
+}
+
+void LoopOptimizer::optimize()
+{
+  this->walk(this->root);
+}
+
+//
+// inner loops are optimized first
+void LoopOptimizer::walk(Node* node)
+{
+  node->each_child([this](Node*& x) { this->walk(x); });
+
+  if (node->kind == ND_For) {
+    this->optimize_loop(node);
+  }
+}
+
+void LoopOptimizer::optimize_loop(Node* node)
+{
+  //
+  // (parallel for is evaluated by workers without LoopContext
+  //  of outer loops, see Evaluator::eval_parallel_for)
+  if (node->is_parallel ||
+      node->nd_for_iterator->kind != ND_Variable) {
+    return;
+  }
+
+  this->loop = node;
+  this->iterator = node->nd_for_iterator->nd_variable_name->str;
+
+  this->assigned.clear();
+  this->guards.clear();
+  this->has_call = false;
+  this->has_write = false;
+  this->has_resize = false;
+
+  this->scan(node->nd_for_loop_code);
+
+  //
+  // builtin function hides the iterator in evaluator
+  if (this->has_call || this->assigned.contains(this->iterator) ||
+      BuiltinFunc::find(this->iterator)) {
+    return;
+  }
+
+  node->is_unboxed = !this->is_captured(node->nd_for_loop_code);
+
+  this->hoist(node->nd_for_loop_code);
+  this->reduce(node->nd_for_loop_code);
+
+  if (!this->has_resize) {
+    this->guard(node->nd_for_loop_code);
+
+    node->is_vectorized =
+        this->vectorize && node->is_unboxed &&
+        this->is_vectorizable(node->nd_for_loop_code);
+  }
+}
+
+void LoopOptimizer::scan(Node* node)
+{
+  switch (node->kind) {
+    case ND_Assign:
+      if (node->nd_lhs->kind == ND_Variable)
+        this->assigned.emplace(node->nd_lhs->nd_variable_name->str);
+      else
+        this->has_write = true;
+
+      break;
+
+    case ND_Let:
+      this->assigned.emplace(node->nd_let_name->str);
+      break;
+
+    case ND_For:
+      if (node->nd_for_iterator->kind == ND_Variable)
+        this->assigned.emplace(
+            node->nd_for_iterator->nd_variable_name->str);
+
+      break;
+
+    case ND_Try:
+      if (node->nd_catch_name)
+        this->assigned.emplace(node->nd_catch_name->str);
+
+      break;
+
+    case ND_Callfunc:
+      if (auto bfun = get_builtin(node); !bfun)
+        this->has_call = true;
+      else if (std::string_view(bfun->name) == "append")
+        this->has_write = this->has_resize = true;
+
+      break;
+
+    case ND_Function:
+    case ND_SelfFunc:
+      this->has_call = true;
+      return;
+
+    //
+    // (the task runs later with the arguments)
+    case ND_Spawn:
+      this->has_call = true;
+      break;
+  }
+
+  node->each_child([this](Node*& x) { this->scan(x); });
+}
+
+bool LoopOptimizer::is_invariant(Node* node)
+{
+  switch (node->kind) {
+    case ND_Value:
+    case ND_True:
+    case ND_False:
+      return true;
+
+    case ND_Variable:
+      return node->nd_variable_func ||
+             (node->nd_variable_name->str != this->iterator &&
+              !this->assigned.contains(node->nd_variable_name->str));
+
+    case ND_Subscript:
+      if (this->has_write) {
+        return false;
+      }
+
+      [[fallthrough]];
+
+    case ND_Add ... ND_RShift:
+    case ND_BitAnd ... ND_BitOr:
+    case ND_Range:
+    case ND_LogAnd:
+    case ND_LogOr:
+      return this->is_invariant(node->nd_lhs) &&
+             this->is_invariant(node->nd_rhs);
+  }
+
+  return false;
+}
+
+bool LoopOptimizer::is_iterator(Node* node)
+{
+  return node->kind == ND_Variable && !node->nd_variable_func &&
+         node->nd_variable_name->str == this->iterator;
+}
+
+bool LoopOptimizer::is_captured(Node* node)
+{
+  if (this->is_iterator(node)) {
+    return true;
+  }
+
+  switch (node->kind) {
+    case ND_Induction:
+      return false;
+
+    // (operators create a new object)
+    case ND_Add ... ND_RShift:
+    case ND_Bigger ... ND_NotEqual:
+    case ND_BitAnd ... ND_BitOr:
+    case ND_Range:
+    case ND_LogAnd:
+    case ND_LogOr:
+      return this->is_captured_operand(node->nd_lhs) ||
+             this->is_captured_operand(node->nd_rhs);
+
+    case ND_Subscript:
+      return this->is_captured(node->nd_lhs) ||
+             this->is_captured_operand(node->nd_rhs);
+
+    case ND_Callfunc:
+      if (auto bfun = get_builtin(node); bfun && !is_storing(bfun)) {
+        for (auto&& x : node->list) {
+          if (this->is_captured_operand(x)) {
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      break;
+  }
+
+  auto found = false;
+
+  node->each_child(
+      [&](Node*& x) { found = found || this->is_captured(x); });
+
+  return found;
+}
+
+bool LoopOptimizer::is_captured_operand(Node* node)
+{
+  return !this->is_iterator(node) && this->is_captured(node);
+}
+
+//
+// move invariants to preheader.
+// only the nodes evaluated in every iteration are moved.
+// (the value is computed where the node was, on the first
+//  iteration, so the error of it is raised there)
+void LoopOptimizer::hoist(Node*& node)
+{
+  if (this->is_invariant(node)) {
+    if (!is_leaf(node)) {
+      node = this->new_invariant(node);
+    }
+
+    return;
+  }
+
+  switch (node->kind) {
+    case ND_Scope:
+      for (auto&& x : node->list) {
+        this->hoist(x);
+
+        if (has_jump(x)) {
+          break;
+        }
+      }
+
+      break;
+
+    case ND_If:
+      this->hoist(node->nd_if_cond);
+      break;
+
+    case ND_For:
+      this->hoist(node->nd_for_range);
+      break;
+
+    case ND_Let:
+      if (node->nd_let_init) {
+        this->hoist(node->nd_let_init);
+      }
+
+      break;
+
+    case ND_Assign:
+      // (index of lvalue)
+      for (auto x = node->nd_lhs; x->kind == ND_Subscript;
+           x = x->nd_lhs) {
+        this->hoist(x->nd_rhs);
+      }
+
+      this->hoist(node->nd_rhs);
+      break;
+
+    case ND_Callfunc:
+    case ND_List:
+      for (auto&& x : node->list) {
+        this->hoist(x);
+      }
+
+      break;
+
+    //
+    // only the first comparison of chain is always evaluated
+    case ND_Bigger ... ND_NotEqual: {
+      auto x = node;
+
+      while (x->nd_lhs->kind >= ND_Bigger &&
+             x->nd_lhs->kind <= ND_NotEqual) {
+        x = x->nd_lhs;
+      }
+
+      this->hoist(x->nd_lhs);
+      this->hoist(x->nd_rhs);
+      break;
+    }
+
+    case ND_Subscript:
+    case ND_Add ... ND_RShift:
+    case ND_BitAnd ... ND_BitOr:
+    case ND_Range:
+    case ND_LogAnd:
+    case ND_LogOr:
+      this->hoist(node->nd_lhs);
+      this->hoist(node->nd_rhs);
+      break;
+  }
+}
+
+//
+// iterator * step  -->  ND_Induction
+void LoopOptimizer::reduce(Node*& node)
+{
+  if (node->kind == ND_Induction) {
+    return;
+  }
+
+  node->each_child([this](Node*& x) { this->reduce(x); });
+
+  if (node->kind != ND_Mul ||
+      this->loop->list.size() >= max_inductions) {
+    return;
+  }
+
+  auto is_step = [this](Node* x) {
+    return (x->kind == ND_Value &&
+            x->nd_value->type.equals(TYPE_Int)) ||
+           (x->kind == ND_Variable && this->is_invariant(x));
+  };
+
+  if (this->is_iterator(node->nd_lhs) && is_step(node->nd_rhs)) {
+    node = this->new_induction(node, node->nd_rhs);
+  }
+  else if (this->is_iterator(node->nd_rhs) && is_step(node->nd_lhs)) {
+    node = this->new_induction(node, node->nd_lhs);
+  }
+}
+
+//
+// v[iterator]  -->  guarded by loop
+void LoopOptimizer::guard(Node* node)
+{
+  node->each_child([this](Node*& x) { this->guard(x); });
+
+  if (node->kind != ND_Subscript || node->nd_subscript_loop ||
+      !this->is_iterator(node->nd_rhs)) {
+    return;
+  }
+
+  auto vec = node->nd_lhs;
+
+  if (vec->kind != ND_Variable || !this->is_invariant(vec) ||
+      vec->nd_variable_func || BuiltinFunc::find(vec->token->str)) {
+    return;
+  }
+
+  auto [it, is_new] =
+      this->guards.try_emplace(vec->token->str, this->guards.size());
+
+  if (it->second >= max_guards) {
+    this->guards.erase(it);
+    return;
+  }
+
+  node->nd_subscript_loop = this->loop;
+  node->nd_subscript_guard = it->second;
+
+  // the first subscript represents the guard
+  if (is_new) {
+    this->loop->append(node);
+  }
+}
+
+//
+// v[iterator] = expr; ...
+// var = var + expr; ...
+bool LoopOptimizer::is_vectorizable(Node* code)
+{
+  auto found = false;
+
+  std::set<std::string_view> reductions;
+
+  for (auto&& x : code->list) {
+    // (empty statement)
+    if (x->kind == ND_None) {
+      continue;
+    }
+
+    if (x->kind != ND_Assign) {
+      return false;
+    }
+
+    if (x->nd_lhs->kind == ND_Subscript) {
+      if (x->nd_lhs->nd_subscript_loop != this->loop ||
+          !this->is_kernel_expr(x->nd_rhs)) {
+        return false;
+      }
+    }
+    else if (!this->is_reduction(x) ||
+             !reductions.emplace(x->nd_lhs->nd_variable_name->str)
+                  .second) {
+      return false;
+    }
+
+    found = true;
+  }
+
+  return found;
+}
+
+//
+// var = var <op> expr
+// (expr can't read var, since var is assigned in loop)
+bool LoopOptimizer::is_reduction(Node* node)
+{
+  auto var = node->nd_lhs;
+  auto op = node->nd_rhs;
+
+  if (var->kind != ND_Variable || var->nd_variable_func ||
+      BuiltinFunc::find(var->nd_variable_name->str)) {
+    return false;
+  }
+
+  switch (op->kind) {
+    case ND_Add:
+    case ND_BitAnd ... ND_BitOr:
+      return op->nd_lhs->kind == ND_Variable &&
+             op->nd_lhs->nd_variable_name->str ==
+                 var->nd_variable_name->str &&
+             this->is_kernel_expr(op->nd_rhs);
+  }
+
+  return false;
+}
+
+bool LoopOptimizer::is_kernel_expr(Node* node)
+{
+  switch (node->kind) {
+    case ND_Value:
+      return node->nd_value->type.kind == TYPE_Int ||
+             node->nd_value->type.kind == TYPE_Float;
+
+    case ND_Variable:
+      return !node->nd_variable_func &&
+             (this->is_iterator(node) || this->is_invariant(node));
+
+    case ND_Induction:
+      return true;
+
+    // (computed in batch, it may not be computed yet)
+    case ND_Invariant:
+      return this->is_kernel_expr(node->nd_invariant_expr);
+
+    case ND_Subscript:
+      return node->nd_subscript_loop == this->loop;
+
+    case ND_Add ... ND_Div:
+    case ND_BitAnd ... ND_BitOr:
+      return this->is_kernel_expr(node->nd_lhs) &&
+             this->is_kernel_expr(node->nd_rhs);
+  }
+
+  return false;
+}
+
+//
+// let @invN;  (in preheader)
+// and the value is computed at the first use. (ND_Invariant)
+Node* LoopOptimizer::new_invariant(Node* expr)
+{
+  auto& pre = this->loop->nd_for_preheader;
+
+  if (!pre) {
+    pre = new Node(ND_Scope, this->loop->token);
+  }
+
+  auto tok = new Token(*expr->token);
+
+  tok->str = this->source.names.emplace_back(
+      "@inv" + std::to_string(this->count++));
+
+  //
+  // errors around the variable point the original expression
+  auto first = expr;
+  auto last = expr;
+
+  while (!is_leaf(first)) first = first->nd_lhs;
+  while (!is_leaf(last)) last = last->nd_rhs;
+
+  tok->pos = first->token->pos;
+  tok->endpos = last->token->endpos;
+  tok->linenum = first->token->linenum;
+
+  auto let = new Node(ND_Let, expr->token);
+
+  let->nd_let_name = tok;
+
+  pre->append(let);
+
+  auto x = new Node(ND_Invariant, tok);
+
+  x->nd_invariant_name = tok;
+  x->nd_invariant_expr = expr;
+
+  return x;
+}
+
+Node* LoopOptimizer::new_induction(Node* expr, Node* step)
+{
+  auto x = new Node(ND_Induction, expr->token);
+
+  x->nd_induction_loop = this->loop;
+  x->nd_induction_expr = expr;
+  x->nd_induction_step = step;
+  x->nd_induction_index = this->loop->list.size();
+
+  this->loop->append(x);
+
+  return x;
+}
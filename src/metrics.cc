@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "Utils.h"
+#include "Metrics.h"
+
+namespace {
+
+template <class T>
+struct Entry {
+  std::string name;
+  std::string labels;
+
+  std::unique_ptr<T> value;
+};
+
+//
+// metrics by "name{labels}"
+// (created only once for a name, so the lock is short)
+struct Registry {
+  std::mutex mtx;
+
+  std::map<std::string, Entry<std::atomic<int64_t>>> counters;
+  std::map<std::string, Entry<Histogram>> histograms;
+};
+
+Registry& get_registry()
+{
+  static Registry registry;
+
+  return registry;
+}
+
+template <class T>
+T& find_or_create(std::map<std::string, Entry<T>>& map,
+                  std::string const& name, std::string const& labels)
+{
+  auto& registry = get_registry();
+
+  std::lock_guard<std::mutex> lock{registry.mtx};
+
+  auto& entry = map[name + "{" + labels + "}"];
+
+  if (!entry.value) {
+    entry.name = name;
+    entry.labels = labels;
+    entry.value = std::make_unique<T>();
+  }
+
+  return *entry.value;
+}
+
+std::string with_labels(std::string const& name,
+                        std::string const& labels,
+                        std::string const& extra = "")
+{
+  if (labels.empty() && extra.empty()) {
+    return name;
+  }
+
+  if (labels.empty() || extra.empty()) {
+    return name + "{" + labels + extra + "}";
+  }
+
+  return name + "{" + labels + "," + extra + "}";
+}
+
+std::string to_seconds(uint64_t ns)
+{
+  return Utils::format("%.9f", ns / 1e9);
+}
+
+}  // namespace
+
+std::atomic<bool> Metrics::enabled{false};
+
+void Histogram::record(uint64_t ns)
+{
+  this->buckets[index_of(ns)].fetch_add(1, std::memory_order_relaxed);
+
+  this->count.fetch_add(1, std::memory_order_relaxed);
+  this->sum.fetch_add(ns, std::memory_order_relaxed);
+
+  for (auto cur = this->max.load(std::memory_order_relaxed);
+       cur < ns && !this->max.compare_exchange_weak(cur, ns);) {
+  }
+}
+
+uint64_t Histogram::get_count() const
+{
+  return this->count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_sum() const
+{
+  return this->sum.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::get_max() const
+{
+  return this->max.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::quantile(double q) const
+{
+  uint64_t total = 0;
+
+  for (auto&& x : this->buckets) {
+    total += x.load(std::memory_order_relaxed);
+  }
+
+  if (total == 0) {
+    return 0;
+  }
+
+  // rank of the quantile (1 ... total)
+  auto rank = std::max<uint64_t>(q * total + 0.5, 1);
+
+  for (size_t i = 0, seen = 0; i < bucket_count; i++) {
+    seen += this->buckets[i].load(std::memory_order_relaxed);
+
+    if (seen >= rank) {
+      // (no more than the max recorded)
+      return std::min(upper_bound(i), this->get_max());
+    }
+  }
+
+  return this->get_max();
+}
+
+//
+// 0 ... 3 : the value itself
+// 4 ...   : 4 buckets for each power of 2 (by the 2 bits
+//           next to the top bit)
+size_t Histogram::index_of(uint64_t ns)
+{
+  if (ns < 4) {
+    return ns;
+  }
+
+  size_t e = std::bit_width(ns) - 1;
+
+  return (e - 1) * 4 + ((ns >> (e - 2)) & 3);
+}
+
+uint64_t Histogram::upper_bound(size_t index)
+{
+  if (index < 4) {
+    return index;
+  }
+
+  size_t e = index / 4 + 1;
+  uint64_t sub = index % 4;
+
+  return ((4 + sub + 1) << (e - 2)) - 1;
+}
+
+void Metrics::enable()
+{
+  enabled = true;
+}
+
+std::atomic<int64_t>& Metrics::counter(std::string const& name,
+                                       std::string const& labels)
+{
+  return find_or_create(get_registry().counters, name, labels);
+}
+
+Histogram& Metrics::histogram(std::string const& name,
+                              std::string const& labels)
+{
+  return find_or_create(get_registry().histograms, name, labels);
+}
+
+std::string Metrics::label(std::string_view key,
+                           std::string_view value)
+{
+  std::string text{key};
+
+  text += "=\"";
+
+  for (auto c : value) {
+    if (c == '"' || c == '\\') {
+      text += '\\';
+      text += c;
+    }
+    else if (c == '\n') {
+      text += "\\n";
+    }
+    else {
+      text += c;
+    }
+  }
+
+  return text + "\"";
+}
+
+//
+// in the text format of Prometheus.
+// counters named *_total are counter, others are gauge.
+// histograms are shown as summary (quantiles in seconds)
+std::string Metrics::to_text()
+{
+  static constexpr double quantiles[]{0.5, 0.9, 0.99, 0.999};
+
+  auto& registry = get_registry();
+
+  std::lock_guard<std::mutex> lock{registry.mtx};
+
+  std::string text;
+  std::string prev;
+
+  for (auto&& [key, E] : registry.counters) {
+    if (E.name != prev) {
+      auto type = E.name.ends_with("_total") ? "counter" : "gauge";
+
+      text += "# TYPE " + E.name + " " + type + "\n";
+      prev = E.name;
+    }
+
+    text += with_labels(E.name, E.labels) + " " +
+            std::to_string(E.value->load()) + "\n";
+  }
+
+  for (auto&& [key, E] : registry.histograms) {
+    auto& H = *E.value;
+
+    if (E.name != prev) {
+      text += "# TYPE " + E.name + " summary\n";
+      prev = E.name;
+    }
+
+    for (auto q : quantiles) {
+      text += with_labels(E.name, E.labels,
+                          Utils::format("quantile=\"%g\"", q)) +
+              " " + to_seconds(H.quantile(q)) + "\n";
+    }
+
+    text += with_labels(E.name + "_max", E.labels) + " " +
+            to_seconds(H.get_max()) + "\n";
+
+    text += with_labels(E.name + "_sum", E.labels) + " " +
+            to_seconds(H.get_sum()) + "\n";
+
+    text += with_labels(E.name + "_count", E.labels) + " " +
+            std::to_string(H.get_count()) + "\n";
+  }
+
+  return text;
+}
+
+bool Metrics::write_file(char const* path)
+{
+  std::ofstream ofs{path};
+
+  if (!ofs) {
+    return false;
+  }
+
+  ofs << to_text();
+
+  return ofs.good();
+}
+
+Metrics::Timer::Timer(Histogram& histogram)
+    : histogram(histogram),
+      begin(std::chrono::steady_clock::now())
+{
+}
+
+Metrics::Timer::~Timer()
+{
+  auto elapsed = std::chrono::steady_clock::now() - this->begin;
+
+  this->histogram.record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+          .count());
+}
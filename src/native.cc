@@ -0,0 +1,223 @@
+#include <dlfcn.h>
+#include <cstring>
+
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "types/BuiltinFunc.h"
+#include "Error.h"
+#include "Utils.h"
+#include "NativeModule.h"
+#include "Isolate.h"
+#include "metro_native.h"
+
+static_assert(METRO_TYPE_INT == (int)TYPE_Int &&
+              METRO_TYPE_STRING == (int)TYPE_String &&
+              METRO_TYPE_FUNCTION == (int)TYPE_Function &&
+              METRO_TYPE_FUTURE == (int)TYPE_Future &&
+              METRO_TYPE_CHANNEL == (int)TYPE_Channel);
+
+namespace {
+
+//
+// (init function is called in the isolate loading it)
+void api_define(char const* name, metro_native_fn fn)
+{
+  Isolate::current()->get_natives().define(name, fn);
+}
+
+metro_type api_type_of(metro_value const* value)
+{
+  return (metro_type)value->type.kind;
+}
+
+int64_t api_get_int(metro_value const* value)
+{
+  return ((ObjLong const*)value)->value;
+}
+
+double api_get_float(metro_value const* value)
+{
+  return ((ObjFloat const*)value)->value;
+}
+
+int api_get_bool(metro_value const* value)
+{
+  return ((ObjBool const*)value)->value;
+}
+
+size_t api_get_string(metro_value const* value, char* buf,
+                      size_t size)
+{
+  auto s =
+      Utils::Converter::to_utf8(((ObjString const*)value)->value);
+
+  if (size != 0) {
+    auto len = std::min(s.length(), size - 1);
+
+    std::memcpy(buf, s.data(), len);
+    buf[len] = 0;
+  }
+
+  return s.length();
+}
+
+std::vector<Object*> const& get_elements(metro_value const* value)
+{
+  if (value->type.kind == TYPE_Tuple) {
+    return ((ObjTuple const*)value)->elements;
+  }
+
+  return ((ObjVector const*)value)->elements;
+}
+
+size_t api_list_size(metro_value const* value)
+{
+  return get_elements(value).size();
+}
+
+metro_value* api_list_at(metro_value const* value, size_t index)
+{
+  return get_elements(value)[index];
+}
+
+metro_value* api_new_none()
+{
+  return new ObjNone;
+}
+
+metro_value* api_new_int(int64_t value)
+{
+  return new ObjLong(value);
+}
+
+metro_value* api_new_float(double value)
+{
+  return new ObjFloat(value);
+}
+
+metro_value* api_new_bool(int value)
+{
+  return new ObjBool(value != 0);
+}
+
+metro_value* api_new_string(char const* utf8, size_t length)
+{
+  return new ObjString(
+      Utils::Converter::to_wide(std::string(utf8, length)));
+}
+
+metro_value* api_new_vector()
+{
+  return new ObjVector;
+}
+
+void api_vector_append(metro_value* vec, metro_value* value)
+{
+  ((ObjVector*)vec)->append(value);
+}
+
+void api_error(metro_node* node, char const* message)
+{
+  Error(ERR_NativeError, node).suggest(node, message).emit().exit();
+}
+
+metro_api const api = {
+    .abi_version = METRO_NATIVE_ABI_VERSION,
+    .define = api_define,
+    .type_of = api_type_of,
+    .get_int = api_get_int,
+    .get_float = api_get_float,
+    .get_bool = api_get_bool,
+    .get_string = api_get_string,
+    .list_size = api_list_size,
+    .list_at = api_list_at,
+    .new_none = api_new_none,
+    .new_int = api_new_int,
+    .new_float = api_new_float,
+    .new_bool = api_new_bool,
+    .new_string = api_new_string,
+    .new_vector = api_new_vector,
+    .vector_append = api_vector_append,
+    .error = api_error,
+};
+
+}  // namespace
+
+NativeModule::NativeModule()
+    : loading_node(nullptr)
+{
+}
+
+void NativeModule::load(Node* node, std::string const& path)
+{
+  if (this->loaded_paths.contains(path)) {
+    return;
+  }
+
+  auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+  if (!handle) {
+    Error(ERR_CannotLoadNative, node)
+        .suggest(node, dlerror())
+        .emit()
+        .exit();
+  }
+
+  auto init =
+      (metro_native_init_fn)dlsym(handle, METRO_NATIVE_INIT_NAME);
+
+  if (!init) {
+    Error(ERR_CannotLoadNative, node)
+        .suggest(node, "`" METRO_NATIVE_INIT_NAME "` is not exported")
+        .emit()
+        .exit();
+  }
+
+  this->loading_node = node;
+
+  if (init(&api) != 0) {
+    Error(ERR_CannotLoadNative, node)
+        .suggest(node, "initialization failed")
+        .emit()
+        .exit();
+  }
+
+  this->loading_node = nullptr;
+
+  this->loaded_paths.emplace(path);
+}
+
+BuiltinFunc const* NativeModule::find(std::string_view name) const
+{
+  if (auto it = this->table.find(name); it != this->table.end()) {
+    return it->second;
+  }
+
+  return nullptr;
+}
+
+void NativeModule::define(char const* name,
+                          BuiltinFunc::NativeType fn)
+{
+  if (BuiltinFunc::find(name)) {
+    Error(ERR_CannotLoadNative, this->loading_node)
+        .suggest(this->loading_node,
+                 "function `" + std::string(name) +
+                     "` is already defined")
+        .emit()
+        .exit();
+  }
+
+  auto& str = this->names.emplace_back(name);
+  auto& bfun = this->functions.emplace_back(str.c_str(), fn);
+
+  this->table.emplace(str, &bfun);
+}
+
+Object* BuiltinFunc::call_native(Node* node, BF_Args args) const
+{
+  auto ret = this->native(node, args.data(), args.size());
+
+  return ret ? ret : new ObjNone;
+}
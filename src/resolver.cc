@@ -0,0 +1,100 @@
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "types/BuiltinFunc.h"
+#include "Utils.h"
+#include "Resolver.h"
+
+Resolver::Resolver(Node* root)
+    : root(root)
+{
+}
+
+void Resolver::resolve()
+{
+  for (auto&& bfun : BuiltinFunc::builtin_functions) {
+    ObjFunction::from_builtin(bfun);
+  }
+
+  this->collect(this->root);
+  this->bind(this->root);
+}
+
+void Resolver::collect(Node* node)
+{
+  switch (node->kind) {
+    case ND_Function:
+      this->functions[node->nd_func_name->str].emplace_back(node);
+
+      node->nd_func_object = ObjFunction::new_immortal(node);
+
+      for (auto&& arg : node->list) {
+        this->variable_names.emplace(arg->nd_arg_name->str);
+      }
+
+      break;
+
+    case ND_Let:
+      this->variable_names.emplace(node->nd_let_name->str);
+      break;
+
+    case ND_Try:
+      if (node->nd_catch_name) {
+        this->variable_names.emplace(node->nd_catch_name->str);
+      }
+
+      break;
+
+    case ND_For:
+      if (node->nd_for_iterator->kind == ND_Variable) {
+        this->variable_names.emplace(
+            node->nd_for_iterator->nd_variable_name->str);
+      }
+
+      break;
+
+    case ND_Assign:
+      if (node->nd_lhs->kind == ND_Variable) {
+        this->variable_names.emplace(
+            node->nd_lhs->nd_variable_name->str);
+      }
+
+      break;
+  }
+
+  node->each_child([this](Node*& x) { this->collect(x); });
+}
+
+void Resolver::bind(Node* node)
+{
+  if (node->kind == ND_Variable) {
+    auto name = node->nd_variable_name->str;
+
+    //
+    // builtin function is always found before variables
+    if (auto bfun = BuiltinFunc::find(name); bfun) {
+      node->nd_variable_func = ObjFunction::from_builtin(*bfun);
+      return;
+    }
+
+    //
+    // a function on the top level, which has unique name.
+    // (top level scope is always on the scope stack)
+    if (auto it = this->functions.find(name);
+        it != this->functions.end() && it->second.size() == 1 &&
+        !this->variable_names.contains(name)) {
+      auto func = it->second[0];
+
+      for (auto&& x : this->root->list) {
+        if (x == func) {
+          node->nd_variable_func = func->nd_func_object;
+          break;
+        }
+      }
+    }
+
+    return;
+  }
+
+  node->each_child([this](Node*& x) { this->bind(x); });
+}
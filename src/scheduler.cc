@@ -0,0 +1,222 @@
+#include "Scheduler.h"
+#include "Isolate.h"
+
+namespace {
+
+//
+// limit of threads started by compensate()
+constexpr size_t max_spare_threads = 256;
+
+//
+// scheduler of the thread running now (null if other thread)
+thread_local Scheduler* cur_scheduler;
+thread_local size_t cur_index;
+
+}  // namespace
+
+Scheduler::Scheduler(size_t count)
+    : isolate(Isolate::current()),
+      deques(count + 1),
+      parallelism(count + 1),
+      pending(0),
+      idle(0),
+      blocked(0),
+      is_stopped(false)
+{
+  cur_scheduler = this;
+  cur_index = count;
+
+  for (size_t i = 0; i < count; i++) {
+    this->workers.emplace_back(&Scheduler::worker_routine, this, i);
+  }
+}
+
+Scheduler::~Scheduler()
+{
+  this->wait_all();
+
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    this->is_stopped = true;
+  }
+
+  this->cv.notify_all();
+
+  // (no thread is started after stop)
+  for (auto&& th : this->workers) {
+    th.join();
+  }
+
+  cur_scheduler = nullptr;
+}
+
+void Scheduler::submit(Task&& task)
+{
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    auto index = cur_scheduler == this ? cur_index
+                                       : this->deques.size() - 1;
+
+    this->deques[index].emplace_back(std::move(task));
+    this->pending++;
+
+    this->compensate();
+  }
+
+  this->cv.notify_all();
+}
+
+void Scheduler::wait(std::function<bool()> const& is_done)
+{
+  std::unique_lock<std::mutex> lock{this->mtx};
+
+  if (is_done()) {
+    return;
+  }
+
+  // (threads of ThreadPool are not counted)
+  auto is_counted = cur_scheduler == this;
+
+  if (is_counted) {
+    this->blocked++;
+    this->compensate();
+  }
+
+  this->cv.wait(lock, is_done);
+
+  if (is_counted) {
+    this->blocked--;
+  }
+}
+
+void Scheduler::wait_all()
+{
+  this->wait([this] { return this->pending == 0; });
+}
+
+void Scheduler::notify()
+{
+  {
+    // (is_done of wait() is checked with the mutex)
+    std::lock_guard<std::mutex> lock{this->mtx};
+  }
+
+  this->cv.notify_all();
+}
+
+void Scheduler::enter_blocking()
+{
+  std::lock_guard<std::mutex> lock{this->mtx};
+
+  this->blocked++;
+  this->compensate();
+}
+
+void Scheduler::leave_blocking()
+{
+  std::lock_guard<std::mutex> lock{this->mtx};
+
+  this->blocked--;
+}
+
+Scheduler* Scheduler::current()
+{
+  return cur_scheduler;
+}
+
+void Scheduler::worker_routine(size_t id)
+{
+  cur_scheduler = this;
+  cur_index = id;
+
+  Isolate::Scope scope{this->isolate};
+
+  std::unique_lock<std::mutex> lock{this->mtx};
+
+  while (!this->is_stopped) {
+    if (Task task; this->take(task)) {
+      lock.unlock();
+      this->run(task);
+      lock.lock();
+
+      continue;
+    }
+
+    this->idle++;
+    this->cv.wait(lock);
+    this->idle--;
+  }
+}
+
+bool Scheduler::take(Task& task)
+{
+  // (workers may be still created)
+  auto const count = this->deques.size() - 1;
+  auto const shared = count;
+
+  //
+  // newest task of own deque
+  if (cur_scheduler == this) {
+    if (auto& own = this->deques[cur_index]; !own.empty()) {
+      task = std::move(own.back());
+      own.pop_back();
+
+      return true;
+    }
+  }
+
+  //
+  // oldest task of shared deque, or of other thread
+  auto first = cur_scheduler == this ? cur_index + 1 : 0;
+
+  for (size_t i = 0; i <= count; i++) {
+    auto index = i == 0 ? shared : (first + i - 1) % count;
+
+    if (auto& deque = this->deques[index]; !deque.empty()) {
+      task = std::move(deque.front());
+      deque.pop_front();
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Scheduler::run(Task& task)
+{
+  task();
+
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    this->pending--;
+  }
+
+  this->cv.notify_all();
+}
+
+void Scheduler::compensate()
+{
+  // (the thread which created the scheduler is counted)
+  auto threads = this->workers.size() + 1;
+  auto running = threads - this->idle - this->blocked;
+
+  if (this->idle != 0 || running >= this->parallelism ||
+      threads >= this->parallelism + max_spare_threads ||
+      this->is_stopped) {
+    return;
+  }
+
+  for (auto&& deque : this->deques) {
+    if (!deque.empty()) {
+      // (the thread stays until stop)
+      this->workers.emplace_back(&Scheduler::worker_routine, this,
+                                 this->deques.size() - 1);
+
+      return;
+    }
+  }
+}
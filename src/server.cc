@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "types/Object.h"
+#include "Metrics.h"
+#include "Server.h"
+
+namespace {
+
+//
+// argument of call request to native value
+Isolate::Value to_value(std::string const& arg)
+{
+  auto first = arg.data();
+  auto last = arg.data() + arg.size();
+
+  if (int64_t value;
+      std::from_chars(first, last, value).ptr == last) {
+    return value;
+  }
+
+  if (double value;
+      std::from_chars(first, last, value).ptr == last) {
+    return value;
+  }
+
+  if (arg == "true" || arg == "false") {
+    return arg == "true";
+  }
+
+  return arg;
+}
+
+std::string make_response(bool is_ok, std::string const& body)
+{
+  return (is_ok ? "ok " : "error ") + std::to_string(body.size()) +
+         "\n" + body;
+}
+
+bool send_all(int fd, std::string const& data)
+{
+  for (size_t sent = 0; sent < data.size();) {
+    // (no SIGPIPE if the client is gone)
+    auto n = send(fd, data.data() + sent, data.size() - sent,
+                  MSG_NOSIGNAL);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return false;
+    }
+
+    sent += n;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+Server::Server(Options const& options, size_t workers)
+    : options(options),
+      count(std::max<size_t>(workers, 1)),
+      listen_fd(-1),
+      queue_depth(Metrics::counter("queue_depth")),
+      queue_wait(Metrics::histogram("queue_wait_seconds")),
+      connections(Metrics::counter("connections")),
+      is_stopped(false)
+{
+}
+
+Server::~Server()
+{
+  if (this->listen_fd != -1) {
+    close(this->listen_fd);
+  }
+}
+
+bool Server::serve(char const* path)
+{
+  sockaddr_un addr{};
+
+  if (std::strlen(path) >= sizeof(addr.sun_path)) {
+    std::cerr << "socket path too long: " << path << std::endl;
+    return false;
+  }
+
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path);
+
+  // (left by the previous server)
+  unlink(path);
+
+  this->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+  if (this->listen_fd == -1 ||
+      bind(this->listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(this->listen_fd, SOMAXCONN) == -1) {
+    std::cerr << "cannot listen on " << path << ": "
+              << std::strerror(errno) << std::endl;
+    return false;
+  }
+
+  for (size_t i = 0; i < this->count; i++) {
+    this->workers.emplace_back(&Server::worker_routine, this);
+  }
+
+  while (true) {
+    auto fd =
+        accept4(this->listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+
+      // (shut down by stop)
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{this->mtx};
+
+      if (this->is_stopped) {
+        close(fd);
+        break;
+      }
+
+      this->accepted.emplace_back(fd, Clock::now());
+
+      this->queue_depth = this->accepted.size();
+    }
+
+    this->cv.notify_one();
+  }
+
+  this->stop();
+
+  for (auto&& th : this->workers) {
+    th.join();
+  }
+
+  unlink(path);
+
+  return true;
+}
+
+void Server::worker_routine()
+{
+  std::unique_lock<std::mutex> lock{this->mtx};
+
+  while (true) {
+    this->cv.wait(lock, [this] {
+      return this->is_stopped || !this->accepted.empty();
+    });
+
+    if (this->is_stopped) {
+      break;
+    }
+
+    auto [fd, time] = this->accepted.front();
+
+    this->accepted.pop_front();
+    this->handling.emplace(fd);
+
+    this->queue_depth = this->accepted.size();
+    this->connections = this->handling.size();
+
+    this->queue_wait.record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - time)
+            .count());
+
+    lock.unlock();
+    this->handle(fd);
+    lock.lock();
+
+    this->handling.erase(fd);
+
+    this->connections = this->handling.size();
+
+    close(fd);
+  }
+
+  // (connections accepted after stop)
+  for (auto&& [fd, time] : this->accepted) {
+    close(fd);
+  }
+
+  this->accepted.clear();
+
+  this->queue_depth = 0;
+}
+
+void Server::handle(int fd)
+{
+  std::string buffer;
+  char data[4096];
+
+  while (true) {
+    auto n = recv(fd, data, sizeof(data), 0);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return;
+    }
+
+    buffer.append(data, n);
+
+    for (size_t pos;
+         (pos = buffer.find('\n')) != std::string::npos;) {
+      auto line = buffer.substr(0, pos);
+
+      buffer.erase(0, pos + 1);
+
+      if (line.ends_with('\r')) {
+        line.pop_back();
+      }
+
+      if (line == "metrics") {
+        if (!send_all(fd, make_response(true, Metrics::to_text()))) {
+          return;
+        }
+
+        continue;
+      }
+
+      if (line == "quit") {
+        send_all(fd, make_response(true, ""));
+        this->stop();
+        return;
+      }
+
+      if (!send_all(fd, this->respond(line))) {
+        return;
+      }
+    }
+  }
+}
+
+std::string Server::respond(std::string const& line)
+{
+  std::istringstream ss{line};
+  std::string command, path, name;
+  std::vector<Isolate::Value> args;
+
+  ss >> command >> path;
+
+  if (command == "call") {
+    ss >> name;
+
+    for (std::string arg; ss >> arg;) {
+      args.emplace_back(to_value(arg));
+    }
+  }
+
+  if ((command != "run" && command != "call") || path.empty() ||
+      (command == "call" && name.empty())) {
+    Metrics::counter("invalid_requests_total")++;
+
+    return make_response(false, "invalid request: " + line + "\n");
+  }
+
+  auto labels = Metrics::label("path", path);
+
+  Metrics::counter("requests_total", labels)++;
+
+  Metrics::Timer timer{Metrics::histogram("request_seconds", labels)};
+
+  auto& errors = Metrics::counter("request_errors_total", labels);
+
+  std::error_code ec;
+
+  auto mtime = std::filesystem::last_write_time(path, ec);
+
+  if (ec) {
+    errors++;
+
+    return make_response(false, "cannot open file: " + path + "\n");
+  }
+
+  auto isolate = this->take(path, mtime);
+
+  std::ostringstream out;
+  bool is_ok = true;
+  bool is_compiled = false;
+
+  isolate->set_output(out);
+
+  try {
+    isolate->compile();
+    is_compiled = true;
+
+    if (command == "run") {
+      isolate->execute();
+    }
+    else {
+      // (once for the isolate, and again after run)
+      if (!isolate->is_initialized()) {
+        isolate->initialize();
+      }
+
+      if (auto result = isolate->call_values(name, args); result) {
+        out << result->to_string() << "\n";
+      }
+      else {
+        out << "undefined function: " << name << "\n";
+        is_ok = false;
+      }
+    }
+  }
+  catch (ScriptError const& err) {
+    out << err.what() << "\n";
+    is_ok = false;
+  }
+
+  isolate->set_output(std::cout);
+
+  // (not cached if the script has errors of compile)
+  if (is_compiled) {
+    this->put(path, mtime, std::move(isolate));
+  }
+
+  if (!is_ok) {
+    errors++;
+  }
+
+  return make_response(is_ok, out.str());
+}
+
+std::unique_ptr<Isolate> Server::take(std::string const& path,
+                                      FileTime mtime)
+{
+  // (deleted after unlock)
+  std::vector<std::unique_ptr<Isolate>> old;
+
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    auto& script = this->scripts[path];
+
+    // compiled from the old file
+    if (script.mtime != mtime) {
+      script.mtime = mtime;
+      old.swap(script.idle);
+    }
+
+    if (!script.idle.empty()) {
+      auto isolate = std::move(script.idle.back());
+
+      script.idle.pop_back();
+
+      return isolate;
+    }
+  }
+
+  auto isolate = std::make_unique<Isolate>(this->options);
+
+  isolate->load_file(path.c_str());
+
+  return isolate;
+}
+
+void Server::put(std::string const& path, FileTime mtime,
+                 std::unique_ptr<Isolate>&& isolate)
+{
+  std::lock_guard<std::mutex> lock{this->mtx};
+
+  if (auto& script = this->scripts[path]; script.mtime == mtime) {
+    script.idle.emplace_back(std::move(isolate));
+  }
+}
+
+void Server::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    if (this->is_stopped) {
+      return;
+    }
+
+    this->is_stopped = true;
+
+    // wake up accept() and recv() of connections
+    shutdown(this->listen_fd, SHUT_RDWR);
+
+    for (auto&& fd : this->handling) {
+      shutdown(fd, SHUT_RD);
+    }
+  }
+
+  this->cv.notify_all();
+}
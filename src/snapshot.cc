@@ -0,0 +1,495 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+#include "types/Node.h"
+#include "types/Object.h"
+#include "types/BuiltinFunc.h"
+#include "Snapshot.h"
+
+namespace {
+
+constexpr char magic[8]{'m', 'e', 't', 'r', 'o', 's', 'n', 'p'};
+constexpr uint32_t version = 1;
+
+// index of null pointer
+constexpr uint64_t null_index = std::numeric_limits<uint64_t>::max();
+
+//
+// FNV-1a (same value for every build, unlike std::hash)
+uint64_t fnv1a(void const* data, size_t size,
+               uint64_t hash = 0xcbf29ce484222325)
+{
+  for (size_t i = 0; i < size; i++) {
+    hash ^= ((unsigned char const*)data)[i];
+    hash *= 0x100000001b3;
+  }
+
+  return hash;
+}
+
+//
+// functions of the top level (saved by the index)
+std::vector<Node*> functions_of(Node* root)
+{
+  std::vector<Node*> functions;
+
+  for (auto&& x : root->list) {
+    if (x->kind == ND_Function) {
+      functions.emplace_back(x);
+    }
+  }
+
+  return functions;
+}
+
+//
+// elements of tuple or vector (same layout)
+std::vector<Object*>& elements_of(Object* obj)
+{
+  return ((ObjVector*)obj)->elements;
+}
+
+//
+// ------------------------------------------------
+//  Writer
+//
+//  objects are numbered by collect() first, so that the
+//  count is known before they are written.
+//  errors are thrown as string.
+// ------------------------------------------------
+class Writer {
+ public:
+  Writer(std::ostream& os, Node* root)
+      : os(os),
+        functions(functions_of(root))
+  {
+  }
+
+  template <class T>
+  void put(T const& value)
+  {
+    this->os.write((char const*)&value, sizeof(T));
+  }
+
+  template <class C>
+  void put_string(std::basic_string_view<C> str)
+  {
+    this->put<uint64_t>(str.size());
+    this->os.write((char const*)str.data(), str.size() * sizeof(C));
+  }
+
+  //
+  // number the object and all reachable from it
+  void collect(Object* obj)
+  {
+    auto i = this->objects.size();
+
+    this->index_of(obj);
+
+    // (elements append more objects to the list)
+    for (; i < this->objects.size(); i++) {
+      auto x = this->objects[i];
+
+      if (x->type.kind == TYPE_Tuple || x->type.kind == TYPE_Vector) {
+        for (auto&& e : elements_of(x)) {
+          this->index_of(e);
+        }
+      }
+    }
+  }
+
+  uint64_t index_of(Object* obj)
+  {
+    if (!obj) {
+      return null_index;
+    }
+
+    auto [it, is_new] =
+        this->indices.try_emplace(obj, this->objects.size());
+
+    if (is_new) {
+      this->objects.emplace_back(obj);
+    }
+
+    return it->second;
+  }
+
+  void put_objects()
+  {
+    this->put<uint64_t>(this->objects.size());
+
+    for (auto&& obj : this->objects) {
+      this->put_object(obj);
+    }
+  }
+
+ private:
+  void put_object(Object* obj)
+  {
+    this->put<uint8_t>(obj->type.kind);
+
+    switch (obj->type.kind) {
+      case TYPE_None:
+        break;
+
+      case TYPE_Int:
+        this->put<int64_t>(((ObjLong*)obj)->value);
+        break;
+
+      case TYPE_Float:
+        this->put<float>(((ObjFloat*)obj)->value);
+        break;
+
+      case TYPE_Bool:
+        this->put<uint8_t>(((ObjBool*)obj)->value);
+        break;
+
+      case TYPE_Char:
+        this->put<uint32_t>(((ObjChar*)obj)->value);
+        break;
+
+      case TYPE_String:
+        this->put_string<wchar_t>(((ObjString*)obj)->value);
+        break;
+
+      case TYPE_Tuple:
+      case TYPE_Vector: {
+        auto& elements = elements_of(obj);
+
+        this->put<uint64_t>(elements.size());
+
+        for (auto&& x : elements) {
+          this->put<uint64_t>(this->index_of(x));
+        }
+
+        break;
+      }
+
+      case TYPE_Range: {
+        auto R = (ObjRange*)obj;
+
+        this->put<int64_t>(R->begin);
+        this->put<int64_t>(R->end);
+        this->put<int64_t>(R->step);
+        break;
+      }
+
+      case TYPE_Function: {
+        auto F = (ObjFunction*)obj;
+
+        this->put<uint8_t>(F->is_builtin);
+
+        if (F->is_builtin) {
+          this->put_string<char>(F->builtin->name);
+          break;
+        }
+
+        auto it = std::find(this->functions.begin(),
+                            this->functions.end(), F->func);
+
+        if (it == this->functions.end()) {
+          throw "function not on the top level: " +
+              std::string{F->func->nd_func_name->str};
+        }
+
+        this->put<uint64_t>(it - this->functions.begin());
+        break;
+      }
+
+      default:
+        throw "cannot save " + obj->type.to_string();
+    }
+  }
+
+  std::ostream& os;
+
+  std::vector<Node*> functions;
+
+  std::vector<Object*> objects;
+  std::unordered_map<Object*, uint64_t> indices;
+};
+
+//
+// ------------------------------------------------
+//  Reader
+//
+//  objects are created in order of index, and elements of
+//  lists are relocated after all are created.
+//  errors are thrown as string.
+// ------------------------------------------------
+class Reader {
+ public:
+  Reader(std::istream& is, Node* root)
+      : is(is),
+        functions(functions_of(root))
+  {
+  }
+
+  template <class T>
+  T get()
+  {
+    T value{};
+
+    if (!this->is.read((char*)&value, sizeof(T))) {
+      throw std::string{"unexpected end of file"};
+    }
+
+    return value;
+  }
+
+  template <class C>
+  std::basic_string<C> get_string()
+  {
+    auto size = this->get<uint64_t>();
+
+    std::basic_string<C> str;
+
+    // (by chunks, not to allocate the size of broken file)
+    while (str.size() < size) {
+      auto n = std::min<uint64_t>(size - str.size(), 4096);
+
+      str.resize(str.size() + n);
+
+      if (!this->is.read((char*)(str.data() + str.size() - n),
+                         n * sizeof(C))) {
+        throw std::string{"unexpected end of file"};
+      }
+    }
+
+    return str;
+  }
+
+  void get_objects()
+  {
+    for (auto count = this->get<uint64_t>(); count > 0; count--) {
+      this->objects.emplace_back(this->get_object());
+    }
+
+    for (auto&& [obj, indices] : this->lists) {
+      for (auto&& i : indices) {
+        elements_of(obj).emplace_back(this->object_at(i));
+      }
+
+      obj->update_size();
+    }
+  }
+
+  Object* object_at(uint64_t index)
+  {
+    if (index == null_index) {
+      return nullptr;
+    }
+
+    if (index >= this->objects.size()) {
+      throw std::string{"invalid index of object"};
+    }
+
+    return this->objects[index];
+  }
+
+ private:
+  Object* get_object()
+  {
+    switch (this->get<uint8_t>()) {
+      case TYPE_None:
+        return new ObjNone;
+
+      case TYPE_Int:
+        return new ObjLong(this->get<int64_t>());
+
+      case TYPE_Float:
+        return new ObjFloat(this->get<float>());
+
+      case TYPE_Bool:
+        return new ObjBool(this->get<uint8_t>());
+
+      case TYPE_Char:
+        return new ObjChar(this->get<uint32_t>());
+
+      case TYPE_String:
+        return new ObjString(this->get_string<wchar_t>());
+
+      case TYPE_Tuple:
+        return this->get_list(new ObjTuple);
+
+      case TYPE_Vector:
+        return this->get_list(new ObjVector);
+
+      case TYPE_Range: {
+        auto begin = this->get<int64_t>();
+        auto end = this->get<int64_t>();
+        auto step = this->get<int64_t>();
+
+        if (step == 0) {
+          throw std::string{"invalid range"};
+        }
+
+        return new ObjRange(begin, end, step);
+      }
+
+      case TYPE_Function: {
+        if (this->get<uint8_t>()) {
+          auto name = this->get_string<char>();
+
+          if (auto b = BuiltinFunc::find(name); b) {
+            return ObjFunction::from_builtin(*b);
+          }
+
+          throw "undefined function: " + name;
+        }
+
+        auto index = this->get<uint64_t>();
+
+        if (index >= this->functions.size()) {
+          throw std::string{"invalid index of function"};
+        }
+
+        return this->functions[index]->nd_func_object;
+      }
+    }
+
+    throw std::string{"invalid kind of object"};
+  }
+
+  //
+  // indices of elements (relocated by get_objects)
+  Object* get_list(Object* obj)
+  {
+    auto& indices = this->lists.emplace_back(obj, 0).second;
+
+    for (auto count = this->get<uint64_t>(); count > 0; count--) {
+      indices.emplace_back(this->get<uint64_t>());
+    }
+
+    return obj;
+  }
+
+  std::istream& is;
+
+  std::vector<Node*> functions;
+
+  std::vector<Object*> objects;
+
+  std::vector<std::pair<Object*, std::vector<uint64_t>>> lists;
+};
+
+}  // namespace
+
+uint64_t Snapshot::hash_of(Source const& source,
+                           Isolate::Options const& options)
+{
+  auto hash = fnv1a(source.text.data(), source.text.size());
+
+  // (program is changed by them)
+  uint64_t flags[]{options.inline_functions, options.inline_size,
+                   options.optimize_loops, options.vectorize_loops,
+                   sizeof(wchar_t)};
+
+  return fnv1a(flags, sizeof(flags), hash);
+}
+
+//
+// magic, version, hash
+// objects: count, then (kind, value) of each
+// variables: count, then (name, index of value) of each
+bool Snapshot::write(char const* path, uint64_t hash, Node* root,
+                     Globals const& vars)
+{
+  std::ofstream ofs{path, std::ios::binary};
+
+  if (!ofs) {
+    std::cerr << "cannot write snapshot: " << path << std::endl;
+    return false;
+  }
+
+  Writer writer{ofs, root};
+
+  try {
+    for (auto&& [name, value] : vars) {
+      writer.collect(value);
+    }
+
+    ofs.write(magic, sizeof(magic));
+
+    writer.put<uint32_t>(version);
+    writer.put<uint64_t>(hash);
+
+    writer.put_objects();
+
+    writer.put<uint64_t>(vars.size());
+
+    for (auto&& [name, value] : vars) {
+      writer.put_string<char>(name);
+      writer.put<uint64_t>(writer.index_of(value));
+    }
+  }
+  catch (std::string const& err) {
+    ofs.close();
+    std::remove(path);
+
+    std::cerr << "cannot write snapshot: " << path << ": " << err
+              << std::endl;
+    return false;
+  }
+
+  return ofs.good();
+}
+
+bool Snapshot::read(char const* path, uint64_t hash, Node* root,
+                    Globals& vars)
+{
+  std::ifstream ifs{path, std::ios::binary};
+
+  if (!ifs) {
+    std::cerr << "cannot open snapshot: " << path << std::endl;
+    return false;
+  }
+
+  Reader reader{ifs, root};
+
+  try {
+    char head[sizeof(magic)];
+
+    if (!ifs.read(head, sizeof(head)) ||
+        !std::equal(head, head + sizeof(head), magic) ||
+        reader.get<uint32_t>() != version) {
+      throw std::string{"not a snapshot of this version"};
+    }
+
+    if (reader.get<uint64_t>() != hash) {
+      throw std::string{"made from other source or options"};
+    }
+
+    reader.get_objects();
+
+    for (auto count = reader.get<uint64_t>(); count > 0; count--) {
+      auto name = reader.get_string<char>();
+      auto value = reader.object_at(reader.get<uint64_t>());
+
+      // (name must live with the program)
+      auto it = std::find_if(
+          root->list.begin(), root->list.end(), [&name](Node* x) {
+            return x->kind == ND_Let && x->nd_let_name->str == name;
+          });
+
+      if (it == root->list.end()) {
+        throw "undefined variable: " + name;
+      }
+
+      vars.emplace_back((*it)->nd_let_name->str, value);
+    }
+  }
+  catch (std::string const& err) {
+    vars.clear();
+
+    std::cerr << "invalid snapshot: " << path << ": " << err
+              << std::endl;
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <utility>
+
+#include "ThreadPool.h"
+#include "Error.h"
+#include "Isolate.h"
+
+namespace {
+
+//
+// pool of the worker thread running now (null if other thread)
+thread_local ThreadPool* cur_pool;
+
+//
+// range of indices owned by a thread in run_split
+struct Part {
+  std::mutex mtx;
+
+  size_t begin;
+  size_t end;
+};
+
+}  // namespace
+
+ThreadPool::ThreadPool(size_t count)
+    : isolate(Isolate::current()),
+      job(nullptr),
+      running(0),
+      generation(0),
+      is_failed(false),
+      is_stopped(false)
+{
+  // the caller of run() is also a worker (thread 0)
+  for (size_t i = 1; i < count; i++) {
+    this->workers.emplace_back(&ThreadPool::worker_routine, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    this->is_stopped = true;
+  }
+
+  this->cv_start.notify_all();
+
+  for (auto&& th : this->workers) {
+    th.join();
+  }
+}
+
+size_t ThreadPool::size() const
+{
+  return this->workers.size() + 1;
+}
+
+void ThreadPool::run(size_t count,
+                     std::function<void(size_t)> const& fn)
+{
+  std::atomic<size_t> next_index{0};
+
+  this->dispatch([&](size_t) {
+    for (size_t i; !this->is_failed && (i = next_index++) < count;) {
+      fn(i);
+    }
+  });
+}
+
+void ThreadPool::run_split(
+    size_t count, size_t grain,
+    std::function<void(size_t, size_t, size_t)> const& fn)
+{
+  auto const n = this->size();
+
+  std::vector<Part> parts(n);
+
+  for (size_t i = 0; i < n; i++) {
+    parts[i].begin = count / n * i + std::min(i, count % n);
+    parts[i].end = count / n * (i + 1) + std::min(i + 1, count % n);
+  }
+
+  grain = std::max<size_t>(grain, 1);
+
+  this->dispatch([&](size_t id) {
+    auto& own = parts[id];
+
+    while (!this->is_failed) {
+      size_t begin = 0;
+      size_t end = 0;
+
+      {
+        std::lock_guard<std::mutex> lock{own.mtx};
+
+        if (own.begin < own.end) {
+          begin = own.begin;
+          end = own.begin += std::min(grain, own.end - own.begin);
+        }
+      }
+
+      if (begin < end) {
+        fn(id, begin, end);
+        continue;
+      }
+
+      //
+      // steal from others.
+      // no more work is given to any part, so all parts are
+      // finished if nothing is found here.
+      for (size_t k = 1; k < n && begin == end; k++) {
+        auto& victim = parts[(id + k) % n];
+
+        std::lock_guard<std::mutex> lock{victim.mtx};
+
+        if (auto rest = victim.end - victim.begin; rest != 0) {
+          end = victim.end;
+          begin = victim.end -= (rest + 1) / 2;
+        }
+      }
+
+      if (begin == end) {
+        break;
+      }
+
+      std::lock_guard<std::mutex> lock{own.mtx};
+
+      own.begin = begin;
+      own.end = end;
+    }
+  });
+}
+
+void ThreadPool::dispatch(std::function<void(size_t)> const& job)
+{
+  {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    this->job = &job;
+    this->running = this->workers.size();
+    this->generation++;
+  }
+
+  this->cv_start.notify_all();
+
+  this->run_job(job, 0);
+
+  std::unique_lock<std::mutex> lock{this->mtx};
+
+  this->cv_done.wait(lock, [this] { return this->running == 0; });
+
+  this->job = nullptr;
+  this->is_failed = false;
+
+  if (auto error = std::exchange(this->error, nullptr); error) {
+    Error::rethrow(error);
+  }
+}
+
+void ThreadPool::run_job(std::function<void(size_t)> const& job,
+                         size_t id)
+{
+  // (the error is shown by the caller of run)
+  Error::enter_try();
+
+  try {
+    job(id);
+  }
+  catch (...) {
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    if (!this->error) {
+      this->error = std::current_exception();
+    }
+
+    this->is_failed = true;
+  }
+
+  Error::leave_try();
+}
+
+ThreadPool* ThreadPool::current()
+{
+  return cur_pool;
+}
+
+void ThreadPool::worker_routine(size_t id)
+{
+  cur_pool = this;
+
+  Isolate::Scope scope{this->isolate};
+
+  size_t seen = 0;
+
+  while (true) {
+    std::function<void(size_t)> const* job;
+
+    {
+      std::unique_lock<std::mutex> lock{this->mtx};
+
+      this->cv_start.wait(lock, [&] {
+        return this->is_stopped || this->generation != seen;
+      });
+
+      if (this->is_stopped) {
+        return;
+      }
+
+      seen = this->generation;
+      job = this->job;
+    }
+
+    this->run_job(*job, id);
+
+    std::lock_guard<std::mutex> lock{this->mtx};
+
+    if (--this->running == 0) {
+      this->cv_done.notify_one();
+    }
+  }
+}
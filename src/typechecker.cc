@@ -0,0 +1,700 @@
+#include "types/Object.h"
+#include "types/Node.h"
+#include "types/Token.h"
+#include "Error.h"
+#include "Utils.h"
+#include "TypeChecker.h"
+
+namespace {
+
+std::pair<std::string_view, TypeKind> const type_names[]{
+    {"int", TYPE_Int},       {"float", TYPE_Float},
+    {"bool", TYPE_Bool},     {"char", TYPE_Char},
+    {"string", TYPE_String}, {"tuple", TYPE_Tuple},
+    {"vec", TYPE_Vector},    {"vector", TYPE_Vector},
+    {"range", TYPE_Range},   {"func", TYPE_Function},
+    {"function", TYPE_Function},
+    {"future", TYPE_Future}, {"channel", TYPE_Channel},
+};
+
+//
+// result of binary operator (same as Evaluator::compute_expr)
+// returns TYPE_None if it is invalid
+TypeKind binary_result(NodeKind kind, TypeKind lhs, TypeKind rhs)
+{
+  // int, float --> float, float
+  if ((lhs == TYPE_Int && rhs == TYPE_Float) ||
+      (lhs == TYPE_Float && rhs == TYPE_Int)) {
+    lhs = rhs = TYPE_Float;
+  }
+
+  if (kind == ND_Mul && lhs == TYPE_Int && rhs == TYPE_String) {
+    return TYPE_String;
+  }
+
+  if (lhs != rhs) {
+    return TYPE_None;
+  }
+
+  switch (kind) {
+    case ND_Add:
+      if (lhs == TYPE_String) {
+        return lhs;
+      }
+
+      [[fallthrough]];
+
+    case ND_Sub:
+    case ND_Mul:
+    case ND_Div:
+    case ND_Mod:
+      if (lhs == TYPE_Int || lhs == TYPE_Float) {
+        return lhs;
+      }
+
+      break;
+
+    case ND_LShift:
+    case ND_RShift:
+    case ND_BitAnd:
+    case ND_BitXor:
+    case ND_BitOr:
+      if (lhs == TYPE_Int) {
+        return lhs;
+      }
+
+      break;
+
+    case ND_LogAnd:
+    case ND_LogOr:
+      if (lhs == TYPE_Bool) {
+        return lhs;
+      }
+
+      break;
+  }
+
+  return TYPE_None;
+}
+
+std::string type_mismatch_text(TypeKind expected, TypeKind found)
+{
+  return "expected `" + Type(expected).to_string() +
+         "`, but found `" + Type(found).to_string() + "`";
+}
+
+}  // namespace
+
+TypeChecker::TypeChecker(Node* root)
+    : root(root),
+      is_final(false),
+      is_changed(false)
+{
+}
+
+void TypeChecker::check()
+{
+  //
+  // types of variables only become unknown,
+  // so this reaches fixed point
+  do {
+    this->is_changed = false;
+    this->walk(this->root);
+  } while (this->is_changed);
+
+  this->is_final = true;
+  this->walk(this->root);
+
+  //
+  // don't run the script which has type errors
+  Error::check();
+}
+
+TypeKind TypeChecker::walk(Node* node)
+{
+  if (!node) {
+    return TYPE_None;
+  }
+
+  TypeKind type = TYPE_None;
+  bool checked = false;
+
+  switch (node->kind) {
+    case ND_Value:
+      type = node->nd_value->type.kind;
+      break;
+
+    case ND_True:
+    case ND_False:
+      type = TYPE_Bool;
+      break;
+
+    case ND_List:
+      for (auto&& x : node->list) {
+        this->walk(x);
+      }
+
+      [[fallthrough]];
+
+    case ND_EmptyList:
+      type = TYPE_Vector;
+      break;
+
+    case ND_SelfFunc:
+      type = TYPE_Function;
+      break;
+
+    case ND_Variable: {
+      if (node->nd_variable_func) {
+        type = TYPE_Function;
+        break;
+      }
+
+      auto name = node->nd_variable_name->str;
+
+      if (auto decl = this->find_decl(name);
+          decl && !this->is_rebound(name)) {
+        type = this->get_var_type(decl, name);
+      }
+
+      break;
+    }
+
+    case ND_Callfunc:
+      type = this->walk_callfunc(node);
+      break;
+
+    case ND_Spawn:
+      this->walk(node->nd_spawn_call);
+      type = TYPE_Future;
+      break;
+
+    case ND_Subscript: {
+      auto lhs = this->walk(node->nd_lhs);
+      auto index = this->walk(node->nd_rhs);
+
+      if (this->is_final && lhs != TYPE_None && lhs != TYPE_Vector) {
+        Error(ERR_TypeMismatch, node->nd_lhs)
+            .suggest(node->nd_lhs,
+                     "expected `vector` or `tuple`, but found `" +
+                         Type(lhs).to_string() + "`")
+            .emit();
+      }
+
+      if (this->is_final && index != TYPE_None && index != TYPE_Int) {
+        Error(ERR_TypeMismatch, node->nd_rhs)
+            .suggest(node->nd_rhs, "expected integer")
+            .emit();
+      }
+
+      checked = lhs == TYPE_Vector && index == TYPE_Int;
+      break;
+    }
+
+    case ND_Add ... ND_RShift:
+    case ND_BitAnd ... ND_BitOr:
+    case ND_LogAnd:
+    case ND_LogOr: {
+      auto lhs = this->walk(node->nd_lhs);
+      auto rhs = this->walk(node->nd_rhs);
+
+      if (lhs != TYPE_None && rhs != TYPE_None) {
+        type = binary_result(node->kind, lhs, rhs);
+
+        if (type == TYPE_None) {
+          if (this->is_final) {
+            Error(ERR_InvalidOperator, node->token).emit();
+          }
+
+          break;
+        }
+
+        checked = true;
+      }
+
+      //
+      // these are checked on runtime even if operands are unknown
+      else if (node->kind >= ND_LShift && node->kind <= ND_BitOr) {
+        type = TYPE_Int;
+      }
+      else if (node->kind == ND_LogAnd || node->kind == ND_LogOr) {
+        type = TYPE_Bool;
+      }
+
+      break;
+    }
+
+    case ND_Bigger:
+    case ND_BiggerOrEqual:
+    case ND_Equal:
+    case ND_NotEqual:
+      type = this->walk_compare(node, checked);
+      break;
+
+    case ND_Range: {
+      auto begin = this->walk(node->nd_lhs);
+      auto end = this->walk(node->nd_rhs);
+
+      if (this->is_final) {
+        for (auto&& [x, t] : {std::pair{node->nd_lhs, begin},
+                              std::pair{node->nd_rhs, end}}) {
+          if (t != TYPE_None && t != TYPE_Int) {
+            Error(ERR_TypeMismatch, x)
+                .suggest(x, "expected integer")
+                .emit();
+          }
+        }
+      }
+
+      type = TYPE_Range;
+      checked = begin == TYPE_Int && end == TYPE_Int;
+      break;
+    }
+
+    case ND_Assign: {
+      auto rhs = this->walk(node->nd_rhs);
+
+      if (node->nd_lhs->kind == ND_Variable) {
+        auto name = node->nd_lhs->nd_variable_name->str;
+
+        this->assign(node, this->find_decl(name), name, rhs);
+      }
+
+      this->walk(node->nd_lhs);
+
+      type = rhs;
+      break;
+    }
+
+    case ND_If: {
+      auto cond = this->walk(node->nd_if_cond);
+
+      if (this->is_final && cond != TYPE_None && cond != TYPE_Bool) {
+        Error(ERR_TypeMismatch, node->nd_if_cond)
+            .suggest(node->nd_if_cond, "condition must boolean")
+            .emit();
+      }
+
+      checked = cond == TYPE_Bool;
+
+      auto t = this->walk(node->nd_if_true);
+      auto f = this->walk(node->nd_if_false);
+
+      if (node->nd_if_false && t == f) {
+        type = t;
+      }
+
+      break;
+    }
+
+    case ND_For: {
+      auto base = this->variables.size();
+      auto range = this->walk(node->nd_for_range);
+
+      if (this->is_final && range != TYPE_None &&
+          range != TYPE_Range && range != TYPE_Vector &&
+          range != TYPE_Channel) {
+        Error(ERR_TypeMismatch, node->nd_for_range)
+            .suggest(node->nd_for_range,
+                     "`" + Type(range).to_string() +
+                         "` is not iterable")
+            .emit();
+      }
+
+      auto& loop = this->loops.emplace_back(Loop{base, {}});
+
+      for (auto&& x : node->nd_for_loop_code->list) {
+        if (x->kind == ND_Let) {
+          loop.names.emplace(x->nd_let_name->str);
+        }
+      }
+
+      if (node->nd_for_iterator->kind == ND_Variable) {
+        this->declare(node,
+                      node->nd_for_iterator->nd_variable_name->str,
+                      range == TYPE_Range ? TYPE_Int : TYPE_None,
+                      false);
+      }
+      else {
+        this->walk(node->nd_for_iterator);
+      }
+
+      if (auto pre = node->nd_for_preheader; pre) {
+        for (auto&& x : pre->list) {
+          this->walk(x);
+        }
+      }
+
+      this->walk(node->nd_for_loop_code);
+
+      this->variables.resize(base);
+      this->loops.pop_back();
+      break;
+    }
+
+    case ND_Induction:
+      type = this->walk(node->nd_induction_expr);
+      break;
+
+    case ND_Invariant:
+      type = this->walk(node->nd_invariant_expr);
+      break;
+
+    case ND_Try: {
+      auto base = this->variables.size();
+      auto t = this->walk(node->nd_try_code);
+
+      if (node->nd_catch_name) {
+        this->declare(node, node->nd_catch_name->str, TYPE_String,
+                      false);
+      }
+
+      auto c = this->walk(node->nd_catch_code);
+
+      this->variables.resize(base);
+
+      if (t == c) {
+        type = t;
+      }
+
+      break;
+    }
+
+    case ND_Return: {
+      type = this->walk(node->nd_return_expr);
+
+      if (!this->functions.empty()) {
+        auto func = this->functions.back();
+        auto ret = this->get_annotation(func->nd_func_return_type);
+
+        if (this->is_final && node->nd_return_expr &&
+            ret != TYPE_None && type != TYPE_None && type != ret) {
+          Error(ERR_TypeMismatch, node->nd_return_expr)
+              .suggest(node->nd_return_expr,
+                       type_mismatch_text(ret, type))
+              .emit();
+        }
+      }
+
+      type = TYPE_None;
+      break;
+    }
+
+    case ND_Let: {
+      auto annotation = this->get_annotation(node->nd_let_type);
+      auto init = this->walk(node->nd_let_init);
+
+      if (annotation != TYPE_None) {
+        if (this->is_final && init != TYPE_None &&
+            init != annotation) {
+          Error(ERR_TypeMismatch, node->nd_let_init)
+              .suggest(node->nd_let_init,
+                       type_mismatch_text(annotation, init))
+              .emit();
+        }
+
+        checked = init == annotation;
+      }
+
+      this->declare(node, node->nd_let_name->str,
+                    annotation != TYPE_None ? annotation : init,
+                    annotation != TYPE_None);
+
+      break;
+    }
+
+    case ND_Scope: {
+      auto base = this->variables.size();
+
+      for (auto&& x : node->list) {
+        this->walk(x);
+      }
+
+      this->variables.resize(base);
+      break;
+    }
+
+    case ND_Function: {
+      auto base = this->variables.size();
+
+      this->func_bases.emplace_back(base);
+      this->functions.emplace_back(node);
+
+      for (auto&& arg : node->list) {
+        auto annotation = arg->kind == ND_Argument
+                              ? this->get_annotation(arg->nd_arg_type)
+                              : TYPE_None;
+
+        this->declare(arg, arg->nd_arg_name->str, annotation,
+                      annotation != TYPE_None);
+      }
+
+      this->get_annotation(node->nd_func_return_type);
+
+      this->walk(node->nd_func_code);
+
+      this->variables.resize(base);
+      this->func_bases.pop_back();
+      this->functions.pop_back();
+
+      type = TYPE_Function;
+      break;
+    }
+
+    default:
+      node->each_child([this](Node*& x) { this->walk(x); });
+      break;
+  }
+
+  this->mark(node, type, checked);
+
+  return type;
+}
+
+TypeKind TypeChecker::walk_compare(Node* node, bool& checked)
+{
+  //
+  // a < b < c ... is evaluated from the innermost lhs
+  // (same as Evaluator::eval)
+  std::vector<Node*> items{node};
+  Node* x = node->nd_lhs;
+
+  for (; x->kind >= ND_Bigger && x->kind <= ND_NotEqual;
+       x = x->nd_lhs) {
+    items.emplace_back(x);
+  }
+
+  auto lhs = this->walk(x);
+
+  for (auto it = items.rbegin(); it != items.rend(); it++) {
+    auto item = *it;
+    auto rhs = this->walk(item->nd_rhs);
+
+    auto is_same = lhs != TYPE_None && lhs == rhs &&
+                   (lhs == TYPE_Int || lhs == TYPE_Float);
+
+    if (this->is_final && lhs != TYPE_None && rhs != TYPE_None &&
+        lhs != rhs && binary_result(ND_Sub, lhs, rhs) != TYPE_Float) {
+      Error(ERR_TypeMismatch, node).emit();
+    }
+
+    if (item != node) {
+      this->mark(item, TYPE_Bool, is_same);
+    }
+    else {
+      checked = is_same;
+    }
+
+    lhs = rhs;
+  }
+
+  return TYPE_Bool;
+}
+
+TypeKind TypeChecker::walk_callfunc(Node* node)
+{
+  auto functor = node->nd_callfunc_functor;
+
+  this->walk(functor);
+
+  std::vector<TypeKind> args;
+
+  for (auto&& x : node->list) {
+    args.emplace_back(this->walk(x));
+  }
+
+  //
+  // callee is known
+  Node* callee = nullptr;
+
+  if (functor->kind == ND_Variable && functor->nd_variable_func) {
+    auto obj = (ObjFunction*)functor->nd_variable_func;
+
+    if (!obj->is_builtin) {
+      callee = obj->func;
+    }
+  }
+  else if (functor->kind == ND_SelfFunc && !this->functions.empty()) {
+    callee = this->functions.back();
+  }
+
+  if (!callee) {
+    return TYPE_None;
+  }
+
+  if (this->is_final) {
+    auto formal = callee->list.begin();
+    auto is_variadic = false;
+
+    for (size_t i = 0; i < args.size(); i++, formal++) {
+      if (formal == callee->list.end()) {
+        Error(ERR_TooManyArguments, node)
+            .suggest(node->list[i], "don't need this argument")
+            .emit();
+
+        break;
+      }
+
+      if ((*formal)->kind == ND_VariableArguments) {
+        is_variadic = true;
+        break;
+      }
+
+      auto expected = this->get_annotation((*formal)->nd_arg_type);
+
+      if (expected != TYPE_None && args[i] != TYPE_None &&
+          args[i] != expected) {
+        Error(ERR_TypeMismatch, node->list[i])
+            .suggest(node->list[i],
+                     type_mismatch_text(expected, args[i]))
+            .emit();
+      }
+    }
+
+    if (!is_variadic && formal != callee->list.end() &&
+        (*formal)->kind != ND_VariableArguments) {
+      Error(ERR_TooFewArguments, node).emit();
+    }
+  }
+
+  // return type is checked on runtime
+  return this->get_annotation(callee->nd_func_return_type);
+}
+
+TypeKind TypeChecker::get_annotation(Node* type)
+{
+  if (!type) {
+    return TYPE_None;
+  }
+
+  for (auto&& [name, kind] : type_names) {
+    if (type->token->str == name) {
+      type->expr_type = kind;
+      return kind;
+    }
+  }
+
+  if (this->is_final) {
+    Error(ERR_UnknownTypeName, type).emit();
+  }
+
+  return TYPE_None;
+}
+
+Node* TypeChecker::find_decl(std::string_view name)
+{
+  auto base = this->func_bases.empty() ? 0 : this->func_bases.back();
+
+  for (auto i = this->variables.size(); i-- > base;) {
+    if (this->variables[i].name == name) {
+      return this->variables[i].decl;
+    }
+  }
+
+  return nullptr;
+}
+
+//
+// the variable of the body is kept between iterations,
+// so a use before the let finds it on the next one
+bool TypeChecker::is_rebound(std::string_view name)
+{
+  auto base = this->func_bases.empty() ? 0 : this->func_bases.back();
+
+  for (auto i = this->variables.size(); i-- > base;) {
+    if (this->variables[i].name != name) {
+      continue;
+    }
+
+    // (declared outside of the loop)
+    for (auto&& loop : this->loops) {
+      if (i < loop.base && loop.names.contains(name)) {
+        return true;
+      }
+    }
+
+    break;
+  }
+
+  return false;
+}
+
+TypeKind TypeChecker::get_var_type(Node* decl, std::string_view name)
+{
+  if (this->free_assigned.contains(name)) {
+    return TYPE_None;
+  }
+
+  if (auto it = this->var_types.find(decl);
+      it != this->var_types.end()) {
+    return it->second;
+  }
+
+  return TYPE_None;
+}
+
+void TypeChecker::declare(Node* decl, std::string_view name,
+                          TypeKind type, bool is_annotated)
+{
+  this->variables.emplace_back(Variable{name, decl});
+
+  if (is_annotated) {
+    this->annotations.emplace(decl, type);
+  }
+
+  //
+  // first visit
+  if (auto [it, inserted] = this->var_types.emplace(decl, type);
+      !inserted && it->second != type && !is_annotated) {
+    if (it->second != TYPE_None) {
+      this->is_changed = true;
+    }
+
+    it->second = TYPE_None;
+  }
+}
+
+void TypeChecker::assign(Node* node, Node* decl,
+                         std::string_view name, TypeKind type)
+{
+  //
+  // free variable: any variable which has same name may be changed
+  if (!decl) {
+    if (this->free_assigned.emplace(name).second) {
+      this->is_changed = true;
+    }
+
+    return;
+  }
+
+  if (auto it = this->annotations.find(decl);
+      it != this->annotations.end() && type != TYPE_None) {
+    if (this->is_final && type != it->second) {
+      Error(ERR_TypeMismatch, node->nd_rhs)
+          .suggest(node->nd_rhs, type_mismatch_text(it->second, type))
+          .emit();
+    }
+
+    return;
+  }
+
+  auto& cur = this->var_types[decl];
+
+  if (cur == type) {
+    return;
+  }
+
+  if (cur != TYPE_None) {
+    this->is_changed = true;
+  }
+
+  cur = TYPE_None;
+}
+
+void TypeChecker::mark(Node* node, TypeKind type, bool checked)
+{
+  if (this->is_final) {
+    node->expr_type = type;
+    node->type_checked = checked;
+  }
+}
@@ -2,13 +2,23 @@
 
 Node::Node(NodeKind kind, Token* token)
     : kind(kind),
-      token(token)
+      token(token),
+      expr_type(TYPE_None),
+      type_checked(false),
+      is_unboxed(false),
+      is_vectorized(false),
+      is_parallel(false)
 {
 }
 
 Node::Node(NodeKind kind, Token* token, Node* lhs, Node* rhs)
     : kind(kind),
-      token(token)
+      token(token),
+      expr_type(TYPE_None),
+      type_checked(false),
+      is_unboxed(false),
+      is_vectorized(false),
+      is_parallel(false)
 {
   this->nd_lhs = lhs;
   this->nd_rhs = rhs;
@@ -1,18 +1,26 @@
 #include "types/Object.h"
+#include "types/BuiltinFunc.h"
 #include "Utils.h"
 #include "GC.h"
+#include "Isolate.h"
 
 Object::Object(Type const& type)
     : type(type),
-      ref_count(1)
+      ref_count(1),
+      buffer_bytes(0)
 {
-  MetroGC::get_instance()->append(this);
+  Isolate::current()->get_heap().append(this);
 }
 
 Object::~Object()
 {
 }
 
+void Object::update_size()
+{
+  Isolate::current()->get_heap().resize(this, this->buffer_size());
+}
+
 ObjNone::ObjNone()
     : Object(TYPE_None)
 {
@@ -43,7 +51,11 @@ ObjList<k, begin, end>::ObjList()
 template <TypeKind k, char begin, char end>
 Object*& ObjList<k, begin, end>::append(Object* obj)
 {
-  return this->elements.emplace_back(obj);
+  auto& ref = this->elements.emplace_back(obj);
+
+  this->update_size();
+
+  return ref;
 }
 
 template <TypeKind k, char begin, char end>
@@ -69,6 +81,8 @@ ObjList<k, begin, end>* ObjList<k, begin, end>::clone() const
     x->elements.emplace_back(elem->clone());
   }
 
+  x->update_size();
+
   return x;
 }
 
@@ -76,22 +90,26 @@ ObjString::ObjString(std::wstring&& val)
     : Object(TYPE_String),
       value(std::move(val))
 {
+  this->update_size();
 }
 
 ObjString::ObjString(std::wstring const& val)
     : Object(TYPE_String),
       value(val)
 {
+  this->update_size();
 }
 
 void ObjString::append(wchar_t ch)
 {
   this->value.push_back(ch);
+  this->update_size();
 }
 
 void ObjString::append(std::wstring const& s)
 {
   this->value.append(s);
+  this->update_size();
 }
 
 std::string ObjString::to_string() const
@@ -127,21 +145,27 @@ ObjFloat* ObjFloat::clone() const
   return new ObjFloat(this->value);
 }
 
-ObjRange::ObjRange(ValueType begin, ValueType end)
+ObjRange::ObjRange(ValueType begin, ValueType end, ValueType step)
     : Object(TYPE_Range),
       begin(begin),
-      end(end)
+      end(end),
+      step(step)
 {
 }
 
 std::string ObjRange::to_string() const
 {
+  if (this->step != 1) {
+    return Utils::format("range(%ld, %ld, %ld)", this->begin,
+                         this->end, this->step);
+  }
+
   return Utils::format("%lu..%lu", this->begin, this->end);
 }
 
 ObjRange* ObjRange::clone() const
 {
-  return new ObjRange(begin, end);
+  return new ObjRange(begin, end, step);
 }
 
 ObjFunction::ObjFunction(Node* func)
@@ -165,15 +189,73 @@ ObjFunction* ObjFunction::clone() const
   return new ObjFunction(*this);
 }
 
+ObjFunction* ObjFunction::new_immortal(Node* func)
+{
+  auto x = new ObjFunction(func);
+
+  Isolate::current()->get_heap().remove(x);
+
+  return x;
+}
+
 ObjFunction* ObjFunction::from_builtin(BuiltinFunc const& b)
 {
-  auto x = new ObjFunction(nullptr);
+  if (auto x = b.object.load(); x) {
+    return x;
+  }
+
+  auto x = new_immortal(nullptr);
 
   x->is_builtin = true;
   x->builtin = &b;
 
+  //
+  // builtin functions are shared by isolates.
+  // (the loser of race uses the other one)
+  if (ObjFunction* other = nullptr;
+      !b.object.compare_exchange_strong(other, x)) {
+    delete x;
+    return other;
+  }
+
   return x;
 }
 
+ObjFuture::ObjFuture()
+    : Object(TYPE_Future),
+      state(std::make_shared<State>())
+{
+}
+
+std::string ObjFuture::to_string() const
+{
+  return this->state->is_done ? "<future done>" : "<future>";
+}
+
+ObjFuture* ObjFuture::clone() const
+{
+  auto x = new ObjFuture;
+
+  x->state = this->state;
+
+  return x;
+}
+
+ObjChannel::ObjChannel(std::shared_ptr<Channel> channel)
+    : Object(TYPE_Channel),
+      channel(std::move(channel))
+{
+}
+
+std::string ObjChannel::to_string() const
+{
+  return "<channel>";
+}
+
+ObjChannel* ObjChannel::clone() const
+{
+  return new ObjChannel(this->channel);
+}
+
 template struct ObjList<TYPE_Tuple, '(', ')'>;
 template struct ObjList<TYPE_Vector, '[', ']'>;
@@ -3,7 +3,8 @@
 
 static char const* typename_list[]{
     "none",  "int", "float", "bool",    "char", "string",
-    "tuple", "vec", "range", "arglist", "func",
+    "tuple", "vec", "range", "arglist", "func", "future",
+    "channel",
 };
 
 std::string Type::to_string() const